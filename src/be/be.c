@@ -24,6 +24,7 @@
 
 #include "hardware/rtc.h"
 
+#include "panel/ambient.h"
 #include "panel/panel_msg_hndlr.h"
 
 #include <stdlib.h>
@@ -32,8 +33,10 @@
 
 static switch_id_t _bank1_sw_pressed = SW_NONE;
 static cmt_msg_t _bank1_sw_longpress_msg = { MSG_B1SW_LONGPRESS_DELAY };
+static cmt_handle_t _bank1_sw_longpress_handle = CMT_HANDLE_INVALID;
 static switch_id_t _bank2_sw_pressed = SW_NONE;
 static cmt_msg_t _bank2_sw_longpress_msg = { MSG_B2SW_LONGPRESS_DELAY };
+static cmt_handle_t _bank2_sw_longpress_handle = CMT_HANDLE_INVALID;
 static bool _input_sw_pressed;
 static cmt_msg_t _input_sw_debounce_msg = { MSG_INPUT_SW_DEBOUNCE };
 static config_t* _last_cfg;
@@ -71,10 +74,12 @@ static const msg_handler_entry_t _switch_longpress_b1_handler_entry = { MSG_B1SW
 static const msg_handler_entry_t _switch_longpress_b2_handler_entry = { MSG_B2SW_LONGPRESS_DELAY, _handle_switch_longpress_delay };
 static const msg_handler_entry_t _ui_initialized_handler_entry = { MSG_UI_INITIALIZED, _handle_ui_initialized };
 
-// For performance - put these in order that we expect to receive more often
+// Dispatch is by message ID (table lookup), so the order here doesn't matter.
 static const msg_handler_entry_t* _be_handler_entries[] = {
     & _panal_repeat_21ms_handler_entry,
     & cmt_sm_tick_handler_entry,
+    & cmt_call_handler_entry,
+    & cmt_call_timeout_handler_entry,
     & _panel_slowblnk_handler_entry,
     & _os_ir_frame_handler_entry,
     & _os_rc_action_handler_entry,
@@ -89,24 +94,27 @@ static const msg_handler_entry_t* _be_handler_entries[] = {
     ((msg_handler_entry_t*)0), // Last entry must be a NULL
 };
 
-static const idle_fn _be_idle_functions[] = {
-    // Cast needed do to definition needed to avoid circular reference.
-    (idle_fn)_be_idle_function_1,
-    (idle_fn)_be_idle_function_2,
-    (idle_fn)0, // Last entry must be a NULL
+// Cast needed do to definition needed to avoid circular reference.
+static const idle_poller_entry_t _input_sw_check_poller_entry = { (idle_fn)_be_idle_function_1, 50 };
+static const idle_poller_entry_t _periodic_updates_poller_entry = { (idle_fn)_be_idle_function_2, 1000 };
+
+static const idle_poller_entry_t* _be_idle_pollers[] = {
+    & _input_sw_check_poller_entry,
+    & _periodic_updates_poller_entry,
+    ((idle_poller_entry_t*)0), // Last entry must be a NULL
 };
 
 msg_loop_cntx_t be_msg_loop_cntx = {
     BE_CORE_NUM, // Back-end runs on Core 0
     _be_handler_entries,
-    _be_idle_functions,
+    _be_idle_pollers,
 };
 
 // ====================================================================
 // Idle functions
 //
 // Something to do when there are no messages to process.
-// (These are cycled through, so do one task.)
+// (These are polled no more often than the period in their entry.)
 // ====================================================================
 
 /**
@@ -139,23 +147,27 @@ static void _be_idle_function_2() {
 // ====================================================================
 
 static void _handle_be_test(cmt_msg_t* msg) {
-    // Test `scheduled_msg_ms` error
-    static int times = 1;
+    // Test the periodic scheduled message accumulated error
+    static int times = 0;
     static cmt_msg_t msg_time = { MSG_BE_TEST };
+    static cmt_handle_t test_handle = CMT_HANDLE_INVALID;
 
     uint64_t period = 60;
+    uint64_t now = now_us();
 
-    if (debug_mode_enabled()) {
-        uint64_t now = now_us();
-
-        uint64_t last_time = msg->data.ts_us;
-        int64_t error = ((now - last_time) - (period * 1000 * 1000));
-        float error_per_ms = ((error * 1.0) / (period * 1000.0));
-        info_printf(true, "\n%5.5d - Scheduled msg delay error us/ms:%5.2f\n", times, error_per_ms);
+    if (CMT_HANDLE_INVALID == test_handle) {
+        // First time (posted at init) - Start the periodic test message.
+        msg_time.data.ts_us = now;
+        test_handle = cmt_schedule_periodic(BE_CORE_NUM, (period * 1000), (period * 1000), &msg_time);
+        return;
     }
-    msg_time.data.ts_us = now_us(); // Get the 'next' -> 'last_time' fresh
-    schedule_msg_in_ms((period * 1000), &msg_time);
     times++;
+    if (debug_mode_enabled()) {
+        uint64_t start_time = msg->data.ts_us;
+        int64_t error = ((now - start_time) - (times * period * 1000 * 1000));
+        float error_per_ms = ((error * 1.0) / (times * period * 1000.0));
+        info_printf(true, "\n%5.5d - Scheduled msg accumulated error us:%lld us/ms:%5.2f\n", times, error, error_per_ms);
+    }
 }
 
 static void _handle_config_changed(cmt_msg_t* msg) {
@@ -177,10 +189,12 @@ static void _handle_input_sw_debounce(cmt_msg_t* msg) {
 
 static void _handle_panel_repeat_21ms(cmt_msg_t* msg) {
     // The panel repeat-21ms is a repetitive message that occurs every 21ms.
-    // We use it to poll the switch banks if they are enabled.
+    // We use it to poll the switch banks if they are enabled, and to
+    // read the ambient light (both use the ADC, so they are done here).
     if (_ui_initialized) {
         curswitch_trigger_read();
     }
+    ambient_update();
 }
 
 static void _handle_switch_action(cmt_msg_t* msg) {
@@ -196,64 +210,63 @@ static void _handle_switch_action(cmt_msg_t* msg) {
     bool pressed = msg->data.sw_action.pressed;
     switch (bank) {
         case SWBANK1:
+            // Clear any long press in progress
+            cmt_cancel(_bank1_sw_longpress_handle);
+            _bank1_sw_longpress_handle = CMT_HANDLE_INVALID;
             if (!pressed) {
-                // Clear any long press in progress
-                scheduled_msg_cancel(MSG_B1SW_LONGPRESS_DELAY);
                 _bank1_sw_pressed = SW_NONE;
             }
             else {
-                // Start a delay timer
+                // Start a delay timer (that then repeats)
                 switch_action_data_t *sad = &_bank1_sw_longpress_msg.data.sw_action;
                 _bank1_sw_pressed = sw_id;
                 sad->bank = bank;
                 sad->switch_id = sw_id;
                 sad->pressed = true;
                 sad->repeat = false;
-                schedule_msg_in_ms(config_current()->long_press, &_bank1_sw_longpress_msg);
+                _bank1_sw_longpress_handle = cmt_schedule_periodic(BE_CORE_NUM, config_current()->long_press, SWITCH_REPEAT_MS, &_bank1_sw_longpress_msg);
             }
             break;
         case SWBANK2:
+            // Clear any long press in progress
+            cmt_cancel(_bank2_sw_longpress_handle);
+            _bank2_sw_longpress_handle = CMT_HANDLE_INVALID;
             if (!pressed) {
-                // Clear any long press in progress
-                scheduled_msg_cancel(MSG_B2SW_LONGPRESS_DELAY);
                 _bank2_sw_pressed = SW_NONE;
             }
             else {
-                // Start a delay timer
+                // Start a delay timer (that then repeats)
                 switch_action_data_t *sad = &_bank2_sw_longpress_msg.data.sw_action;
                 _bank2_sw_pressed = sw_id;
                 sad->bank = bank;
                 sad->switch_id = sw_id;
                 sad->pressed = true;
                 sad->repeat = false;
-                schedule_msg_in_ms(config_current()->long_press, &_bank2_sw_longpress_msg);
+                _bank2_sw_longpress_handle = cmt_schedule_periodic(BE_CORE_NUM, config_current()->long_press, SWITCH_REPEAT_MS, &_bank2_sw_longpress_msg);
             }
             break;
     }
 }
 
 static void _handle_switch_longpress_delay(cmt_msg_t* msg) {
-    // Handle the long press delay message to see if the switch is still pressed.
+    // Handle the (periodic) long press delay message to see if the switch is still pressed.
     switch_bank_t bank = msg->data.sw_action.bank;
     switch_id_t sw_id = msg->data.sw_action.switch_id;
     bool repeat = msg->data.sw_action.repeat;
     cmt_msg_t* slpmsg = NULL;
+    cmt_handle_t* slphandle = NULL;
     switch (bank) {
         case SWBANK1:
-            if (sw_id == _bank1_sw_pressed) {
-                // Prepare to post another delay msg.
-                slpmsg = &_bank1_sw_longpress_msg;
-            }
-            else {
+            slpmsg = &_bank1_sw_longpress_msg;
+            slphandle = &_bank1_sw_longpress_handle;
+            if (sw_id != _bank1_sw_pressed) {
                 sw_id = SW_NONE;
             }
             break;
         case SWBANK2:
-            if (sw_id == _bank2_sw_pressed) {
-                // Prepare to post another delay msg.
-                slpmsg = &_bank2_sw_longpress_msg;
-            }
-            else {
+            slpmsg = &_bank2_sw_longpress_msg;
+            slphandle = &_bank2_sw_longpress_handle;
+            if (sw_id != _bank2_sw_pressed) {
                 sw_id = SW_NONE;
             }
             break;
@@ -269,14 +282,13 @@ static void _handle_switch_longpress_delay(cmt_msg_t* msg) {
         msg.data.sw_action.pressed = true;
         msg.data.sw_action.repeat = repeat;
         postBothMsgNoWait(&msg);
-        // Schedule another delay
-        switch_action_data_t* sad = &slpmsg->data.sw_action;
-        sad->bank = bank;
-        sad->switch_id = sw_id;
-        sad->pressed = true;
-        sad->repeat = true;
-        uint16_t delay = (repeat ? SWITCH_REPEAT_MS : config_current()->long_press);
-        schedule_msg_in_ms(delay, slpmsg);
+        // The following (periodic) delays are repeats
+        slpmsg->data.sw_action.repeat = true;
+    }
+    else if (slphandle) {
+        // The switch isn't pressed any more. Stop the delay timer.
+        cmt_cancel(*slphandle);
+        *slphandle = CMT_HANDLE_INVALID;
     }
 }
 
@@ -309,16 +321,12 @@ static void _input_sw_irq_handler(uint32_t events) {
     // Anything shorter is probably the IR, which is handled by PIO.
     if (events & GPIO_IRQ_EDGE_FALL) {
         // Delay to see if it is user input or an IR received.
-        // Check to see if we have already scheduled a debounce message.
-        if (!scheduled_message_exists(MSG_INPUT_SW_DEBOUNCE)) {
-            schedule_msg_in_ms(80, &_input_sw_debounce_msg);
-        }
+        // (edges until then are merged into the one debounce message)
+        cmt_throttle_trailing(&_input_sw_debounce_msg, 80);
     }
     if (events & GPIO_IRQ_EDGE_RISE) {
         // If we haven't recorded the input switch as pressed, this is probably the IR-B
-        if (scheduled_message_exists(MSG_INPUT_SW_DEBOUNCE)) {
-            scheduled_msg_cancel(MSG_INPUT_SW_DEBOUNCE);
-        }
+        scheduled_msg_cancel(MSG_INPUT_SW_DEBOUNCE);
         if (_input_sw_pressed) {
             _input_sw_pressed = false;
             cmt_msg_t msg = { MSG_INPUT_SW_RELEASE };
@@ -341,6 +349,7 @@ void be_module_init() {
     _last_cfg = config_new(cfg);
     panel_type_t panel_type = config_sys()->panel_type;
     panel_module_init(panel_type);
+    ambient_module_init();
 
     // Done with the Backend Initialization - Let the UI know.
     _msg_be_initialized.id = MSG_BE_INITIALIZED;
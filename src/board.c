@@ -39,7 +39,9 @@
 #include "display/oled1106_spi/display_oled1106.h"
 #include "board.h"
 #include "debug_support.h"
+#include "cmt/alarm.h"
 #include "cmt/multicore.h"
+#include "cmt/task.h"
 #include "net/net.h"
 #include "rc/rc.h"
 #include "term/term.h"
@@ -274,6 +276,14 @@ int board_init() {
 
     // Initialize the multicore subsystem
     multicore_module_init();
+    // If a message loop stall caused a reboot, run in diagnostic mode (debug on, watchdog not armed).
+    if (cmt_diag_mode()) {
+        cmt_crash_record_t cr;
+        cmt_crash_record(&cr);
+        debug_mode_enable(true);
+        error_printf(false, "Rebooted after a message loop stall - Diagnostic Mode. Core:%d Msg:0x%03X Fn:%p Stalled-ms:%u\n",
+            cr.corenum, cr.msg_id, cr.fn, cr.stalled_ms);
+    }
 
     puts("\033[32mScores says hello!\033[0m");
 
@@ -302,7 +312,8 @@ void tone_sound_duration(int ms) {
         sleep_ms(ms);
         _tone_sound_duration_cont(NULL);
     }
-    else {
+    else if (CMT_ALARM_INVALID == cmt_alarm_us_call((uint32_t)ms * 1000, _tone_sound_duration_cont, NULL)) {
+        // No alarm available. Use the (message loop) sleep.
         cmt_sleep_ms(ms, _tone_sound_duration_cont, NULL);
     }
 }
@@ -311,24 +322,60 @@ void tone_on(bool on) {
     gpio_put(TONE_DRIVE, (on ? TONE_ON : TONE_OFF));
 }
 
-void _tone_on_off_cont(void* data) {
-    int32_t *pattern = (int32_t*)data;
-    tone_on_off(pattern);
+/*
+ * Start one of the on/off pattern tasks. The tasks always run on core 0, so they can be
+ * started from either core (or an IRQ). A task can only be listed on one core.
+ * Returns false if it couldn't be passed to core 0 (no call record, or its queue is full).
+ */
+static bool _on_off_task_start(cmt_call_fn start_fn, const int32_t* pattern) {
+    if (0 == get_core_num() && 0 == __get_current_exception()) {
+        start_fn((void*)pattern);
+        return (true);
+    }
+    cmt_call_handle_t handle = cmt_call_on_core(0, start_fn, (void*)pattern, MSG_COMMON_NOOP, 0);
+    if (CMT_CALL_INVALID == handle) {
+        if (0 == __get_current_exception()) {
+            warn_printf(true, "Board - Could not start an on/off pattern on core 0.\n");
+        }
+        return (false);
+    }
+    return (true);
+}
+
+static const int32_t* _tone_pattern;
+static cmt_task_t _tone_on_off_task;
+
+static cmt_task_status_t _tone_on_off_task_fn(cmt_task_t* task) {
+    CMT_TASK_BEGIN(task);
+    while (*_tone_pattern) {
+        // The alarm ends the tone on time, even if this core is busy when it's due.
+        int32_t on_time = *_tone_pattern++;
+        tone_sound_duration(on_time);
+        if (*_tone_pattern == 0) {
+            break;
+        }
+        CMT_TASK_AWAIT_MS(task, on_time + *_tone_pattern++);
+    }
+    CMT_TASK_END(task);
 }
-void tone_on_off(const int32_t *pattern) {
+static int32_t _tone_on_off_start(void* pattern) {
+    _tone_pattern = (const int32_t*)pattern;
+    cmt_task_start(&_tone_on_off_task, _tone_on_off_task_fn, NULL);
+    return (0);
+}
+bool tone_on_off(const int32_t *pattern) {
+    if (cmt_message_loop_0_running()) {
+        return (_on_off_task_start(_tone_on_off_start, pattern));
+    }
     while (*pattern) {
         tone_sound_duration(*pattern++);
         int off_time = *pattern++;
         if (off_time == 0) {
-            return;
-        }
-        if (!cmt_message_loop_0_running()) {
-            sleep_ms(off_time);
-        }
-        else {
-            cmt_sleep_ms(off_time, _tone_on_off_cont, (void*)pattern);
+            return (true);
         }
+        sleep_ms(off_time);
     }
+    return (true);
 }
 
 static void _led_flash_cont(void* user_data) {
@@ -353,24 +400,40 @@ void led_on(bool on) {
 #endif
 }
 
-void _led_on_off_cont(void* user_data) {
-    int32_t* pattern = (int32_t*)user_data;
-    led_on_off(pattern);
+static const int32_t* _led_pattern;
+static cmt_task_t _led_on_off_task;
+
+static cmt_task_status_t _led_on_off_task_fn(cmt_task_t* task) {
+    CMT_TASK_BEGIN(task);
+    while (*_led_pattern) {
+        led_on(true);
+        CMT_TASK_AWAIT_MS(task, *_led_pattern++);
+        led_on(false);
+        if (*_led_pattern == 0) {
+            break;
+        }
+        CMT_TASK_AWAIT_MS(task, *_led_pattern++);
+    }
+    CMT_TASK_END(task);
+}
+static int32_t _led_on_off_start(void* pattern) {
+    _led_pattern = (const int32_t*)pattern;
+    cmt_task_start(&_led_on_off_task, _led_on_off_task_fn, NULL);
+    return (0);
 }
-void led_on_off(const int32_t *pattern) {
+bool led_on_off(const int32_t *pattern) {
+    if (cmt_message_loop_0_running()) {
+        return (_on_off_task_start(_led_on_off_start, pattern));
+    }
     while (*pattern) {
         led_flash(*pattern++);
         int off_time = *pattern++;
         if (off_time == 0) {
-            return;
-        }
-        if (!cmt_message_loop_0_running()) {
-            sleep_ms(off_time);
-        }
-        else {
-            cmt_sleep_ms(off_time, _led_on_off_cont, (void*)pattern);
+            return (true);
         }
+        sleep_ms(off_time);
     }
+    return (true);
 }
 
 uint32_t now_ms() {
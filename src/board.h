@@ -67,11 +67,15 @@ extern void led_on(bool on);
  * @ingroup board
  *
  * This flashes the LED for times specified by the `pattern` in milliseconds.
+ * Once the core 0 message loop is running, the pattern is run by a task on
+ * core 0 (from either core), and this returns right away. From core 1 (or an
+ * IRQ) it is passed to core 0 with `cmt_call_on_core`, which can fail.
  *
  * @param pattern Array of millisend values to turn the LED on, off, on, etc.
  *      The last element of the array must be 0.
+ * @return true If the pattern was played or started. False if it couldn't be passed to core 0.
 */
-extern void led_on_off(const int32_t* pattern);
+extern bool led_on_off(const int32_t* pattern);
 
 /**
  * @brief Get a millisecond value of the time since the board was booted.
@@ -124,11 +128,15 @@ extern void tone_on(bool on);
  * @ingroup board
  *
  * This beeps the buzzer for times specified by the `pattern` in milliseconds.
+ * Once the core 0 message loop is running, the pattern is run by a task on
+ * core 0 (from either core), and this returns right away. From core 1 (or an
+ * IRQ) it is passed to core 0 with `cmt_call_on_core`, which can fail.
  *
  * @param pattern Array of millisend values to beep the buzzer on, off, on, etc.
  *      The last element of the array must be 0.
+ * @return true If the pattern was played or started. False if it couldn't be passed to core 0.
 */
-extern void tone_on_off(const int32_t* pattern);
+extern bool tone_on_off(const int32_t* pattern);
 
 /**
  * @brief The current state of the User Input Switch
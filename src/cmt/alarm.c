@@ -0,0 +1,213 @@
+/**
+ * scores CMT microsecond alarms.
+ *
+ * One-shot alarms with microsecond resolution, that post a message to a core
+ * or call an ISR-safe function.
+ *
+ * Copyright 2023 AESilky
+ * SPDX-License-Identifier: MIT License
+ *
+*/
+#include "alarm.h"
+#include "multicore.h"
+
+#include "hardware/sync.h"
+#include "pico/time.h"
+
+#include "board.h"
+#include "debug_support.h"
+
+#define _ALARM_INDEX_BITS 8
+#define _ALARM_INDEX_MASK ((1 << _ALARM_INDEX_BITS) - 1)
+
+typedef struct _ALARM_REC_ {
+    struct _ALARM_REC_* next_free;
+    cmt_alarm_fn fn;                // Function to call (NULL to post the message)
+    void* user_data;
+    cmt_msg_t msg;                  // Copy of the message to post
+    alarm_id_t alarm_id;            // The pool's ID for the alarm
+    uint32_t generation;            // Bumped each time the record is freed (stale handles)
+    uint8_t corenum;
+    bool in_use;
+} _alarm_rec_t;
+
+static _alarm_rec_t _alarm_recs[CMT_ALARMS_MAX];
+static _alarm_rec_t* _alarm_free;
+static int _alarms_in_use;
+static volatile uint32_t _alarm_drops;
+static alarm_pool_t* _alarm_pool;
+static spin_lock_t* _alarm_lock;
+
+/**
+ * @brief Get a free record (must be called with the `_alarm_lock` held).
+ */
+static _alarm_rec_t* _rec_alloc() {
+    _alarm_rec_t* rec = _alarm_free;
+    if (rec) {
+        _alarm_free = rec->next_free;
+        rec->next_free = NULL;
+        rec->in_use = true;
+        _alarms_in_use++;
+    }
+    return (rec);
+}
+
+/**
+ * @brief Free a record (must be called with the `_alarm_lock` held).
+ */
+static void _rec_free(_alarm_rec_t* rec) {
+    rec->in_use = false;
+    rec->alarm_id = 0;
+    rec->generation++;
+    rec->next_free = _alarm_free;
+    _alarm_free = rec;
+    _alarms_in_use--;
+}
+
+static cmt_alarm_handle_t _rec_handle(const _alarm_rec_t* rec) {
+    // Index + 1 so a handle is never 0 (CMT_ALARM_INVALID)
+    return ((cmt_alarm_handle_t)((rec->generation << _ALARM_INDEX_BITS) | ((rec - _alarm_recs) + 1)));
+}
+
+/**
+ * @brief Get the record for a handle (must be called with the `_alarm_lock` held).
+ *
+ * @return _alarm_rec_t* The record, or NULL if the handle isn't for a pending alarm.
+ */
+static _alarm_rec_t* _rec_from_handle(cmt_alarm_handle_t handle) {
+    int index = (int)(handle & _ALARM_INDEX_MASK) - 1;
+    if (index < 0 || index >= CMT_ALARMS_MAX) {
+        return (NULL);
+    }
+    _alarm_rec_t* rec = &_alarm_recs[index];
+    if (!rec->in_use || _rec_handle(rec) != handle) {
+        return (NULL);
+    }
+    return (rec);
+}
+
+static void _alarm_fire(cmt_alarm_fn fn, void* user_data, uint8_t corenum, const cmt_msg_t* msg) {
+    if (fn) {
+        fn(user_data);
+        return;
+    }
+    // This is usually the alarm IRQ on core 0, which can't wait for the core 0 loop.
+    bool posted = (0 == corenum ? post_to_core0_nowait(msg) : post_to_core1_nowait(msg));
+    if (!posted) {
+        _alarm_drops++;
+    }
+}
+
+/**
+ * @brief Alarm pool callback.
+ *
+ * @see alarm_callback_t
+ *
+ * @param id The pool's alarm ID.
+ * @param user_data The alarm record.
+ * @return int64_t 0 (one-shot)
+ */
+static int64_t _alarm_callback(alarm_id_t id, void* user_data) {
+    _alarm_rec_t* rec = (_alarm_rec_t*)user_data;
+    uint32_t flags = spin_lock_blocking(_alarm_lock);
+    if (!rec->in_use || rec->alarm_id != id) {
+        // Cancelled (and possibly reused) after the pool started calling us
+        spin_unlock(_alarm_lock, flags);
+        return (0);
+    }
+    // Copy what we need, as the record is free to be reused once it is freed.
+    cmt_alarm_fn fn = rec->fn;
+    void* fn_data = rec->user_data;
+    uint8_t corenum = rec->corenum;
+    cmt_msg_t msg = rec->msg;
+    _rec_free(rec);
+    spin_unlock(_alarm_lock, flags);
+    _alarm_fire(fn, fn_data, corenum, &msg);
+
+    return (0);
+}
+
+static cmt_alarm_handle_t _alarm_add(uint32_t us, cmt_alarm_fn fn, void* user_data, uint8_t corenum, const cmt_msg_t* msg) {
+    uint32_t flags = spin_lock_blocking(_alarm_lock);
+    _alarm_rec_t* rec = _rec_alloc();
+    if (!rec) {
+        spin_unlock(_alarm_lock, flags);
+        return (CMT_ALARM_INVALID);
+    }
+    rec->fn = fn;
+    rec->user_data = user_data;
+    rec->corenum = corenum;
+    if (msg) {
+        rec->msg = *msg;
+    }
+    // Don't have the pool fire a past alarm, as it would call us back from here (with the lock held).
+    alarm_id_t id = alarm_pool_add_alarm_in_us(_alarm_pool, us, _alarm_callback, rec, false);
+    cmt_alarm_handle_t handle = _rec_handle(rec);
+    if (id > 0) {
+        // The callback can't check the ID until we release the lock.
+        rec->alarm_id = id;
+        spin_unlock(_alarm_lock, flags);
+        return (handle);
+    }
+    _rec_free(rec);
+    spin_unlock(_alarm_lock, flags);
+    if (id < 0) {
+        // The pool is out of timers (it has one for each of our records, so this shouldn't happen)
+        return (CMT_ALARM_INVALID);
+    }
+    // Already due. Fire it now. The handle is stale, so a cancel returns false.
+    _alarm_fire(fn, user_data, corenum, msg);
+
+    return (handle);
+}
+
+cmt_alarm_handle_t cmt_alarm_us(uint8_t corenum, uint32_t us, const cmt_msg_t* msg) {
+    return (_alarm_add(us, NULL, NULL, corenum, msg));
+}
+
+cmt_alarm_handle_t cmt_alarm_us_call(uint32_t us, cmt_alarm_fn fn, void* user_data) {
+    return (_alarm_add(us, fn, user_data, 0, NULL));
+}
+
+bool cmt_alarm_cancel(cmt_alarm_handle_t handle) {
+    bool cancelled = false;
+    uint32_t flags = spin_lock_blocking(_alarm_lock);
+    _alarm_rec_t* rec = _rec_from_handle(handle);
+    if (rec) {
+        // If the pool is already calling back, the callback sees that the record was freed.
+        alarm_pool_cancel_alarm(_alarm_pool, rec->alarm_id);
+        _rec_free(rec);
+        cancelled = true;
+    }
+    spin_unlock(_alarm_lock, flags);
+
+    return (cancelled);
+}
+
+int cmt_alarms_in_use() {
+    return (_alarms_in_use);
+}
+
+uint32_t cmt_alarm_drops() {
+    return (_alarm_drops);
+}
+
+void cmt_alarm_module_init() {
+    _alarm_free = NULL;
+    for (int i = CMT_ALARMS_MAX - 1; i >= 0; i--) {
+        _alarm_rec_t* rec = &_alarm_recs[i];
+        rec->generation = 0;
+        rec->next_free = _alarm_free;
+        rec->in_use = false;
+        _alarm_free = rec;
+    }
+    _alarms_in_use = 0;
+    _alarm_drops = 0;
+    _alarm_lock = spin_lock_init(spin_lock_claim_unused(true));
+    // The pool's IRQ is on this core. Give it a timer for each of our records.
+    _alarm_pool = alarm_pool_create_with_unused_hardware_alarm(CMT_ALARMS_MAX);
+    if (!_alarm_pool) {
+        error_printf(false, "CMT - Could not create the alarm pool.\n");
+        panic("CMT - Could not create the alarm pool.");
+    }
+}
@@ -0,0 +1,133 @@
+/**
+ * scores CMT microsecond alarms.
+ *
+ * One-shot alarms with microsecond resolution, that post a message to a core
+ * or call an ISR-safe function.
+ *
+ * Copyright 2023 AESilky
+ * SPDX-License-Identifier: MIT License
+ *
+*/
+#ifndef _CMT_ALARM_H_
+#define _CMT_ALARM_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "cmt.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @file alarm.h
+ * @defgroup cmt_alarm cmt_alarm
+ * Microsecond alarms.
+ *
+ * The alarms are run by an SDK alarm pool on its own hardware alarm, so they
+ * aren't held up by the scheduled messages (or the message loops). The alarm
+ * records are a fixed pool, so setting, cancelling, and firing an alarm never
+ * allocates and can be done from an IRQ handler.
+ *
+ * The alarm IRQ is on core 0 (the pool is created by `cmt_module_init`), so the
+ * functions called by `cmt_alarm_us_call` run in IRQ context on core 0. They
+ * must be short and only use ISR-safe operations.
+ *
+ * @addtogroup cmt_alarm
+ * @include alarm.c
+ *
+*/
+
+/** Number of alarm records (alarms that can be pending at the same time) */
+#ifndef CMT_ALARMS_MAX
+#define CMT_ALARMS_MAX 16
+#endif
+
+/** Handle for a pending alarm. */
+typedef uint32_t cmt_alarm_handle_t;
+
+/** Value for an invalid (or no) alarm handle. */
+#define CMT_ALARM_INVALID ((cmt_alarm_handle_t)0)
+
+/**
+ * @brief Function prototype for an alarm function.
+ * @ingroup cmt_alarm
+ *
+ * Called from the alarm IRQ, so it must be ISR-safe.
+ *
+ * @param user_data The value passed to `cmt_alarm_us_call`.
+ */
+typedef void (*cmt_alarm_fn)(void* user_data);
+
+/**
+ * @brief Post a message to a core after a number of microseconds.
+ * @ingroup cmt_alarm
+ *
+ * The message is copied, so it doesn't need to stay allocated. Can be called
+ * from an IRQ handler.
+ *
+ * The message is posted from the alarm IRQ, which can't wait for the core's
+ * message loop. If the core's queue is full (or there isn't a data slab block)
+ * the message is dropped, and counted (`cmt_alarm_drops` and the `multicore_drops`
+ * of the core).
+ *
+ * @param corenum The core to post the message to.
+ * @param us The number of microseconds from now.
+ * @param msg The message to post.
+ * @return cmt_alarm_handle_t Handle for the alarm, or CMT_ALARM_INVALID if no
+ *      record was available.
+ */
+extern cmt_alarm_handle_t cmt_alarm_us(uint8_t corenum, uint32_t us, const cmt_msg_t* msg);
+
+/**
+ * @brief Call an ISR-safe function after a number of microseconds.
+ * @ingroup cmt_alarm
+ *
+ * If the time is so short that it has already passed when the alarm is added,
+ * the function is called right away (from the caller). Can be called from an
+ * IRQ handler (including from an alarm function).
+ *
+ * @param us The number of microseconds from now.
+ * @param fn The function to call.
+ * @param user_data Value to pass to the function.
+ * @return cmt_alarm_handle_t Handle for the alarm, or CMT_ALARM_INVALID if no
+ *      record was available.
+ */
+extern cmt_alarm_handle_t cmt_alarm_us_call(uint32_t us, cmt_alarm_fn fn, void* user_data);
+
+/**
+ * @brief Cancel a pending alarm.
+ * @ingroup cmt_alarm
+ *
+ * @param handle The alarm handle returned when it was set.
+ * @return true If the alarm was cancelled.
+ * @return false If it has already fired (or the handle isn't valid).
+ */
+extern bool cmt_alarm_cancel(cmt_alarm_handle_t handle);
+
+/**
+ * @brief The number of alarm records currently in use.
+ * @ingroup cmt_alarm
+ *
+ * @return int Number of pending alarms.
+ */
+extern int cmt_alarms_in_use();
+
+/**
+ * @brief The number of alarm messages that were dropped (the core's queue was full).
+ * @ingroup cmt_alarm
+ *
+ * @return uint32_t Number of dropped alarm messages since startup.
+ */
+extern uint32_t cmt_alarm_drops();
+
+/**
+ * @brief Initialize the alarms. Called by `cmt_module_init` (on core 0).
+ * @ingroup cmt_alarm
+ */
+extern void cmt_alarm_module_init();
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _CMT_ALARM_H_
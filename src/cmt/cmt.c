@@ -8,13 +8,19 @@
  *
 */
 #include "cmt.h"
+#include "alarm.h"
+#include "task.h"
+#include "trace.h"
 #include "system_defs.h"
 #include "board.h"
 #include "debug_support.h"
 #include "util/util.h"
 
 #include "hardware/structs/nvic.h"
-#include "pico/mutex.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "hardware/watchdog.h"
+#include "pico/platform.h"
 #include "pico/stdlib.h"
 #include "pico/time.h"
 
@@ -22,73 +28,480 @@
 #include <string.h>
 
 
-#define _SM_OVERHEAD_US_PER_MS 20 // From testing (@SEE be._handle_be_test)
 #define _SMD_FREE_INDICATOR (-1)
+#define _SM_HANDLE_BLOCK_BITS 8
+#define _SM_HANDLE_BLOCK_MASK ((1u << _SM_HANDLE_BLOCK_BITS) - 1)
 
 typedef bool (*get_msg_nowait_fn)(cmt_msg_t* msg);
 
+/**
+ * @brief Scheduled message data.
+ *
+ * The scheduled messages are kept in a min-heap ordered by their absolute
+ * deadline (`time_us_64()` based). A single one-shot hardware alarm is armed
+ * for the deadline at the top of the heap, so there is no periodic tick.
+ *
+ * The slots come from a fixed-block pool with a free list. Slots in use are
+ * also linked into a list for their message ID, so 'exists' and 'cancel'
+ * don't need to scan the schedule.
+ *
+ * Each block has a fixed number in the pool and a generation that changes
+ * each time it is used. These make up the handle returned to the client, so
+ * a stale handle can't affect a block that has been reused.
+ */
 typedef struct _scheduled_msg_data_ {
-    int32_t remaining;
+    uint64_t deadline;          // Absolute time (us since boot) to post the message
+    uint32_t period_us;         // Period for a periodic message (0 for one-shot)
+    uint32_t generation;        // Incremented each time the block is allocated
+    int16_t heap_index;         // Index in the heap or _SMD_FREE_INDICATOR if free
+    int16_t id_index;           // Message ID index (cmt_msg_id_index) or MSG_ID_INDEX_NONE
+    uint8_t block_num;          // Number of this block in the pool
     uint8_t corenum;
     int32_t ms_requested;
     const cmt_msg_t* client_msg;
     cmt_msg_t sleep_msg;
+    bool gate;                  // A debounce/throttle window (see _sm_gate)
+    bool guard;                 // Only times a window (debounce/throttle) - nothing is posted
+    struct _scheduled_msg_data_* next;  // Next in the free list or the ID list
+    struct _scheduled_msg_data_* prev;  // Previous in the ID list
 } _scheduled_msg_data_t;
 
 
-auto_init_mutex(sm_mutex);
-static _scheduled_msg_data_t _scheduled_message_datas[SCHEDULED_MESSAGES_MAX]; // Objects to use (no malloc/free)
-static repeating_timer_t _schd_msg_timer_data;
+static spin_lock_t* _sm_lock;
+static uint _sm_alarm_num;
+static _scheduled_msg_data_t _scheduled_message_datas[SCHEDULED_MESSAGES_MAX]; // Initial pool blocks
+static _scheduled_msg_data_t* _sm_free_list;    // Free pool blocks
+static _scheduled_msg_data_t* _sm_blocks[SCHEDULED_MESSAGES_LIMIT]; // All pool blocks by block number
+static int _sm_pool_capacity;                   // Number of blocks in the pool (grows to SCHEDULED_MESSAGES_LIMIT)
+static _scheduled_msg_data_t* _sm_heap[SCHEDULED_MESSAGES_LIMIT]; // Min-heap of the scheduled messages (by deadline)
+static int _sm_heap_count;
+static int _sm_heap_high_water;
+static _scheduled_msg_data_t* _sm_id_lists[MSG_ID_INDEX_COUNT]; // Scheduled messages by message ID index
 
 static bool _msg_loop_0_running = false;
 static bool _msg_loop_1_running = false;
 
+// Subscribers (one pool for each core). The subscribers for a message ID index `i`
+// are a list starting at `_sub_first[core][i]` (the core's handler entries and
+// `cmt_subscribe`), followed by the list in the active app set `_app_subs[core]`.
+// Only the core itself changes its lists. A removed subscriber keeps its `next` (so
+// a dispatch in progress can step past it) until the loop reclaims it.
+#define _SUB_NONE 0xFF
+typedef struct _CMT_SUB_ {
+    msg_handler_fn handler;         // Handler (from a handler entry), or NULL
+    cmt_subscriber_fn subscriber;   // Subscriber (called with `ctx`), or NULL
+    void* ctx;
+    uint32_t budget_us;             // Execution budget
+    uint8_t next;                   // Next subscriber for the ID (or _SUB_NONE)
+    bool live;                      // False once removed (until reclaimed)
+} _cmt_sub_t;
+static _cmt_sub_t _subs[2][CMT_DISPATCH_HANDLERS_MAX];
+static uint8_t _sub_first[2][MSG_ID_INDEX_COUNT];
+static uint8_t _sub_free[2];                    // Free list (through `next`)
+static uint8_t _sub_removed[2];                 // Number removed waiting to be reclaimed
+static cmt_app_subs_t* _app_subs[2];            // The active app subscriptions
+
+// Handler/poller overruns (a ring of the newest for each core).
+static cmt_overrun_t _overruns[2][CMT_OVERRUNS_MAX];
+static volatile uint32_t _overrun_count[2];
+
+// Stall detection. Each loop updates its heartbeat (`time_us_32()`) every pass and
+// keeps what it is running as its activity, so the other core can tell if it's stuck
+// (and on what). The stall is recorded in the watchdog scratch registers (0-3, the
+// SDK uses 4-7) and survives the reboot.
+#define _CRASH_MAGIC 0x5C0E0000u
+#define _CRASH_MAGIC_MASK 0xFFFF0000u
+#define _CRASH_NEW 0x00000100u
+static volatile uint32_t _loop_heartbeat_us[2];
+static volatile uint16_t _loop_activity_id[2] = { CMT_ACTIVITY_NONE, CMT_ACTIVITY_NONE };
+static void* volatile _loop_activity_fn[2];
+static bool _watchdog_armed;
+static bool _diag_mode;
+static bool _crash_record_valid;
+static cmt_crash_record_t _crash_record;
+
+// Message ID wait/handler time histograms (one per handled ID for each core).
+// `_msg_hist_num` maps a message ID index to the histogram (or _MSG_HIST_NONE).
+#define _MSG_HIST_NONE 0xFF
+static cmt_msg_hist_t _msg_hists[2][CMT_DISPATCH_HANDLERS_MAX];
+static uint8_t _msg_hist_num[2][MSG_ID_INDEX_COUNT];
+static int _msg_hists_count[2];
+static volatile bool _msg_hists_reset[2];
+
 static proc_status_accum_t _psa[2]; // One Proc Status Accumulator for each core
 static proc_status_accum_t _psa_sec[2]; // Proc Status Accumulator per second for each core
+// The per-second values and history are published with a sequence count (odd while
+// they are being updated), so a reader on the other core gets a consistent copy.
+static volatile uint32_t _psa_seq[2];
+static volatile float _core_temp;     // Read by core 0 (the ADC is only used from the core 0 thread)
+typedef struct _PS_HISTORY_ {
+    uint32_t count;                                 // Free-running count of samples written
+    cmt_ps_sample_t samples[CMT_PS_HISTORY_SECS];
+} _ps_history_t;
+static _ps_history_t _ps_history[2];
 
 void cmt_handle_sleep(cmt_msg_t* msg);
 
 const msg_handler_entry_t cmt_sm_tick_handler_entry = { MSG_CMT_SLEEP, cmt_handle_sleep };
 
+// Cross-core calls
+typedef enum _CALL_STATE_ {
+    _CALL_FREE = 0,
+    _CALL_PENDING,                      // Posted to the called core
+    _CALL_RUNNING,                      // The function is running
+    _CALL_TIMEDOUT,                     // Timed out (the called core frees it)
+} _call_state_t;
+
+typedef struct _CMT_CALL_ {
+    cmt_call_fn fn;
+    void* arg;
+    msg_id_t completion_msg_id;
+    uint8_t caller_core;
+    volatile uint8_t state;             // _call_state_t
+    uint16_t generation;                // Changes each time the call record is used (12 bits)
+    cmt_handle_t timeout_handle;
+    cmt_msg_t timeout_msg;
+} _cmt_call_t;
+
+static spin_lock_t* _call_lock;
+static _cmt_call_t _calls[CMT_CALLS_MAX];
+
+static void _handle_call(cmt_msg_t* msg);
+static void _handle_call_timeout(cmt_msg_t* msg);
+
+const msg_handler_entry_t cmt_call_handler_entry = { MSG_CMT_CALL, _handle_call };
+const msg_handler_entry_t cmt_call_timeout_handler_entry = { MSG_CMT_CALL_TIMEOUT, _handle_call_timeout };
+
+// ====================================================================
+// Scheduled message heap (must be called with the `_sm_lock` held)
+// ====================================================================
+
+static void _sm_heap_set(int index, _scheduled_msg_data_t* smd) {
+    _sm_heap[index] = smd;
+    smd->heap_index = index;
+}
+
+static void _sm_heap_sift_up(int index) {
+    _scheduled_msg_data_t* smd = _sm_heap[index];
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (_sm_heap[parent]->deadline <= smd->deadline) {
+            break;
+        }
+        _sm_heap_set(index, _sm_heap[parent]);
+        index = parent;
+    }
+    _sm_heap_set(index, smd);
+}
+
+static void _sm_heap_sift_down(int index) {
+    _scheduled_msg_data_t* smd = _sm_heap[index];
+    while (true) {
+        int child = (2 * index) + 1;
+        if (child >= _sm_heap_count) {
+            break;
+        }
+        if (child + 1 < _sm_heap_count && _sm_heap[child + 1]->deadline < _sm_heap[child]->deadline) {
+            child++;
+        }
+        if (smd->deadline <= _sm_heap[child]->deadline) {
+            break;
+        }
+        _sm_heap_set(index, _sm_heap[child]);
+        index = child;
+    }
+    _sm_heap_set(index, smd);
+}
+
+static void _sm_heap_insert(_scheduled_msg_data_t* smd) {
+    _sm_heap_set(_sm_heap_count++, smd);
+    _sm_heap_sift_up(smd->heap_index);
+}
+
+static void _sm_heap_remove(_scheduled_msg_data_t* smd) {
+    int index = smd->heap_index;
+    smd->heap_index = _SMD_FREE_INDICATOR;
+    _sm_heap_count--;
+    if (index < _sm_heap_count) {
+        // Move the last entry into the hole and restore the heap order.
+        _scheduled_msg_data_t* moved = _sm_heap[_sm_heap_count];
+        _sm_heap_set(index, moved);
+        _sm_heap_sift_up(index);
+        _sm_heap_sift_down(moved->heap_index);
+    }
+}
+
+/**
+ * @brief Put a block on the free list (must be called with the `_sm_lock` held).
+ */
+static void _smd_free(_scheduled_msg_data_t* smd) {
+    smd->heap_index = _SMD_FREE_INDICATOR;
+    smd->next = _sm_free_list;
+    _sm_free_list = smd;
+}
+
 /**
- * @brief Repeating alarm callback handler.
- * Handles the repeating timer, adjusts the time left and posts a message to
- * the appropriate core when time hits 0.
+ * @brief Add blocks to the pool.
  *
- * @see repeating_timer_callback_t
+ * Allocates a chunk of blocks and adds them to the free list. This can't be
+ * done from an interrupt handler (malloc).
  *
- * \param rt repeating time structure containing information about the repeating time. (not used)
- * \return true to continue repeating, false to stop.
+ * @return true if blocks were added.
  */
-bool _schd_msg_timer_callback(repeating_timer_t* rt) {
-    for (int i = 0; i < SCHEDULED_MESSAGES_MAX; i++) {
-        _scheduled_msg_data_t* smd = &_scheduled_message_datas[i];
-        if (smd->remaining > 0) {
-            if (0 == --smd->remaining) {
-                if (0 == smd->corenum) {
-                    post_to_core0_blocking(smd->client_msg);
-                }
-                else {
-                    post_to_core1_blocking(smd->client_msg);
-                }
-                smd->remaining = _SMD_FREE_INDICATOR;
-            }
+static bool _sm_pool_grow() {
+    _scheduled_msg_data_t* chunk = malloc(SCHEDULED_MESSAGES_GROW * sizeof(_scheduled_msg_data_t));
+    if (!chunk) {
+        return (false);
+    }
+    uint32_t flags = spin_lock_blocking(_sm_lock);
+    int count = SCHEDULED_MESSAGES_LIMIT - _sm_pool_capacity;
+    count = (count > SCHEDULED_MESSAGES_GROW ? SCHEDULED_MESSAGES_GROW : count);
+    for (int i = 0; i < count; i++) {
+        _scheduled_msg_data_t* smd = &chunk[i];
+        smd->block_num = _sm_pool_capacity + i;
+        smd->generation = 0;
+        _sm_blocks[smd->block_num] = smd;
+        _smd_free(smd);
+    }
+    _sm_pool_capacity += (count > 0 ? count : 0);
+    spin_unlock(_sm_lock, flags);
+    if (count <= 0) {
+        // The other core grew the pool to the limit while we were allocating.
+        free(chunk);
+        return (false);
+    }
+    return (true);
+}
+
+/**
+ * @brief Get a free block, growing the pool if needed.
+ *
+ * This returns with the `_sm_lock` held (even if a block isn't available).
+ *
+ * @param flags Pointer to the interrupt flags to restore when the lock is released.
+ * @return _scheduled_msg_data_t* A free block or NULL if none are available.
+ */
+static _scheduled_msg_data_t* _smd_alloc(uint32_t* flags) {
+    *flags = spin_lock_blocking(_sm_lock);
+    while (!_sm_free_list && _sm_pool_capacity < SCHEDULED_MESSAGES_LIMIT && 0 == __get_current_exception()) {
+        spin_unlock(_sm_lock, *flags);
+        bool grown = _sm_pool_grow();
+        *flags = spin_lock_blocking(_sm_lock);
+        if (!grown) {
+            break;
+        }
+    }
+    _scheduled_msg_data_t* smd = _sm_free_list;
+    if (smd) {
+        _sm_free_list = smd->next;
+        smd->next = NULL;
+        smd->period_us = 0;
+        smd->gate = false;
+        smd->guard = false;
+        if (0 == (++smd->generation << _SM_HANDLE_BLOCK_BITS)) {
+            smd->generation = 1; // Generation 0 is never handed out (see _smd_handle)
+        }
+    }
+    return (smd);
+}
+
+/**
+ * @brief Get the handle for a block.
+ */
+static cmt_handle_t _smd_handle(const _scheduled_msg_data_t* smd) {
+    // Generation 0 is never handed out, so a handle is never CMT_HANDLE_INVALID.
+    return ((cmt_handle_t)((smd->generation << _SM_HANDLE_BLOCK_BITS) | smd->block_num));
+}
+
+/**
+ * @brief Get the scheduled block for a handle (must be called with the `_sm_lock` held).
+ *
+ * @return _scheduled_msg_data_t* The block or NULL if the handle is no longer scheduled.
+ */
+static _scheduled_msg_data_t* _smd_for_handle(cmt_handle_t handle) {
+    uint block_num = (handle & _SM_HANDLE_BLOCK_MASK);
+    if (CMT_HANDLE_INVALID == handle || block_num >= (uint)_sm_pool_capacity) {
+        return (NULL);
+    }
+    _scheduled_msg_data_t* smd = _sm_blocks[block_num];
+    if (_SMD_FREE_INDICATOR == smd->heap_index || _smd_handle(smd) != handle) {
+        return (NULL);
+    }
+    return (smd);
+}
+
+/**
+ * @brief Link a scheduled block into its message ID list (must be called with the `_sm_lock` held).
+ */
+static void _smd_id_link(_scheduled_msg_data_t* smd) {
+    smd->id_index = cmt_msg_id_index(smd->client_msg->id);
+    smd->prev = NULL;
+    smd->next = NULL;
+    if (MSG_ID_INDEX_NONE != smd->id_index) {
+        _scheduled_msg_data_t* head = _sm_id_lists[smd->id_index];
+        smd->next = head;
+        if (head) {
+            head->prev = smd;
+        }
+        _sm_id_lists[smd->id_index] = smd;
+    }
+}
+
+/**
+ * @brief Unlink a scheduled block from its message ID list (must be called with the `_sm_lock` held).
+ */
+static void _smd_id_unlink(_scheduled_msg_data_t* smd) {
+    if (MSG_ID_INDEX_NONE != smd->id_index) {
+        if (smd->prev) {
+            smd->prev->next = smd->next;
+        }
+        else {
+            _sm_id_lists[smd->id_index] = smd->next;
+        }
+        if (smd->next) {
+            smd->next->prev = smd->prev;
+        }
+    }
+    smd->next = NULL;
+    smd->prev = NULL;
+}
+
+/**
+ * @brief Remove a block from the schedule and free it (must be called with the `_sm_lock` held).
+ */
+static void _smd_unschedule(_scheduled_msg_data_t* smd) {
+    _sm_heap_remove(smd);
+    _smd_id_unlink(smd);
+    _smd_free(smd);
+}
+
+static bool _post_to_core_blocking(uint8_t corenum, const cmt_msg_t* msg) {
+    return (0 == corenum ? post_to_core0_blocking(msg) : post_to_core1_blocking(msg));
+}
+
+/**
+ * @brief Arm the hardware alarm for the earliest deadline (or cancel it if nothing is scheduled).
+ *
+ * If the deadline has already passed the alarm IRQ is forced, so the expired
+ * message(s) get posted as soon as the lock is released.
+ */
+static void _sm_alarm_arm() {
+    if (_sm_heap_count > 0) {
+        absolute_time_t target = from_us_since_boot(_sm_heap[0]->deadline);
+        if (hardware_alarm_set_target(_sm_alarm_num, target)) {
+            // Missed it. Fire now.
+            hardware_alarm_force_irq(_sm_alarm_num);
         }
     }
+    else {
+        hardware_alarm_cancel(_sm_alarm_num);
+    }
+}
 
-    return (true); // Repeat forever
+/**
+ * @brief One-shot alarm callback handler.
+ * Posts all of the messages that have reached their deadline to the appropriate
+ * core and re-arms the alarm for the next deadline.
+ *
+ * This is an IRQ, so the post can't wait for the consumer. A one-shot message that
+ * can't be posted stays scheduled and is tried again CMT_POST_RETRY_MS later, so
+ * it isn't lost. A periodic message that can't be posted misses that period.
+ *
+ * @see hardware_alarm_callback_t
+ *
+ * \param alarm_num The hardware alarm number. (not used)
+ */
+static void _sm_alarm_callback(uint alarm_num) {
+    while (true) {
+        cmt_msg_t msg;
+        uint8_t corenum;
+        uint32_t flags = spin_lock_blocking(_sm_lock);
+        if (_sm_heap_count == 0 || _sm_heap[0]->deadline > time_us_64()) {
+            _sm_alarm_arm();
+            spin_unlock(_sm_lock, flags);
+            break;
+        }
+        _scheduled_msg_data_t* smd = _sm_heap[0];
+        // Copy the message, as the slot is free to be reused once it is removed.
+        msg = *smd->client_msg;
+        corenum = smd->corenum;
+        bool post = !smd->guard;
+        cmt_handle_t retry_handle = CMT_HANDLE_INVALID;
+        if (smd->period_us) {
+            // Periodic - The next deadline is phase-locked to the first one. If we
+            // have fallen more than a period behind, skip to the next one in the future.
+            uint64_t now = time_us_64();
+            smd->deadline += smd->period_us;
+            if (smd->deadline <= now) {
+                smd->deadline += (((now - smd->deadline) / smd->period_us) + 1) * smd->period_us;
+            }
+            _sm_heap_sift_down(0);
+        }
+        else if (post) {
+            // Keep it scheduled (for a retry) until it has been posted.
+            smd->deadline = time_us_64() + (CMT_POST_RETRY_MS * 1000);
+            _sm_heap_sift_down(0);
+            retry_handle = _smd_handle(smd);
+        }
+        else {
+            _smd_unschedule(smd);
+        }
+        spin_unlock(_sm_lock, flags);
+        // Post outside of the lock (a guard just times out).
+        if (post && _post_to_core_blocking(corenum, &msg) && CMT_HANDLE_INVALID != retry_handle) {
+            // Posted. Remove it (unless it was cancelled meanwhile).
+            flags = spin_lock_blocking(_sm_lock);
+            _scheduled_msg_data_t* posted_smd = _smd_for_handle(retry_handle);
+            if (posted_smd) {
+                _smd_unschedule(posted_smd);
+            }
+            spin_unlock(_sm_lock, flags);
+        }
+    }
 }
 
 static void _scheduled_msg_init() {
-    for (int i = 0; i < SCHEDULED_MESSAGES_MAX; i++) {
+    _sm_free_list = NULL;
+    for (int i = SCHEDULED_MESSAGES_MAX - 1; i >= 0; i--) {
         // Initialize these as 'free'
         _scheduled_msg_data_t* smd = &_scheduled_message_datas[i];
-        smd->remaining = _SMD_FREE_INDICATOR;
+        smd->block_num = i;
+        smd->generation = 0;
+        _sm_blocks[i] = smd;
+        _smd_free(smd);
+    }
+    _sm_pool_capacity = SCHEDULED_MESSAGES_MAX;
+    _sm_heap_count = 0;
+    _sm_heap_high_water = 0;
+    for (int i = 0; i < MSG_ID_INDEX_COUNT; i++) {
+        _sm_id_lists[i] = NULL;
+    }
+    _sm_lock = spin_lock_init(spin_lock_claim_unused(true));
+    int alarm_num = hardware_alarm_claim_unused(false);
+    if (alarm_num < 0) {
+        error_printf(false, "CMT - Could not claim a hardware alarm for scheduled messages.\n");
+        panic("CMT - Could not claim a hardware alarm for scheduled messages.");
+    }
+    _sm_alarm_num = (uint)alarm_num;
+    hardware_alarm_set_callback(_sm_alarm_num, _sm_alarm_callback);
+}
+
+/**
+ * @brief Add a slot to the schedule (must be called with the `_sm_lock` held).
+ */
+static void _smd_schedule(_scheduled_msg_data_t* smd, uint8_t corenum, int32_t ms, const cmt_msg_t* msg) {
+    smd->client_msg = msg;
+    smd->ms_requested = ms;
+    smd->corenum = corenum;
+    smd->deadline = time_us_64() + ((uint64_t)(ms > 0 ? ms : 0) * 1000);
+    _sm_heap_insert(smd);
+    _smd_id_link(smd);
+    if (_sm_heap_count > _sm_heap_high_water) {
+        _sm_heap_high_water = _sm_heap_count;
     }
-    bool success = add_repeating_timer_us((1000 - _SM_OVERHEAD_US_PER_MS), _schd_msg_timer_callback, NULL, &_schd_msg_timer_data);
-    if (!success) {
-        error_printf(false, "CMT - Could not create repeating timer for scheduled messages.\n");
-        panic("CMT - Could not create repeating timer for scheduled messages.");
+    if (smd->heap_index == 0) {
+        // This is the new earliest deadline.
+        _sm_alarm_arm();
     }
 }
 
@@ -111,133 +524,272 @@ void cmt_handle_sleep(cmt_msg_t* msg) {
     }
 }
 
+/*
+ * Start reading the values a core's loop publishes. Returns the sequence count to
+ * check with `_psa_read_retry` after the values are copied.
+ */
+static uint32_t _psa_read_begin(uint8_t corenum) {
+    uint32_t seq;
+    while ((seq = _psa_seq[corenum]) & 1) {
+        tight_loop_contents();  // Being updated
+    }
+    __mem_fence_acquire();
+    return (seq);
+}
+
+/*
+ * Check if the values need to be read again (the loop updated them while they were being read).
+ */
+static bool _psa_read_retry(uint8_t corenum, uint32_t seq) {
+    __mem_fence_acquire();
+    return (seq != _psa_seq[corenum]);
+}
+
 void cmt_proc_status_sec(proc_status_accum_t* psas, uint8_t corenum) {
     if (corenum < 2) {
-        proc_status_accum_t* psa_sec = &_psa_sec[corenum];
-        proc_status_accum_t psa;
-        int64_t cs = 0;
+        uint32_t seq;
         do {
-            psa.cs = psa_sec->cs;   // Get the 'per-sec' checksum
-            psa.core_temp = psa_sec->core_temp;
-            psa.idle = psa_sec->idle;
-            cs = psa.idle;
-            psa.retrieved = psa_sec->retrieved;
-            cs += psa.retrieved;
-            psa.t_active = psa_sec->t_active;
-            cs += psa.t_active;
-            psa.t_idle = psa_sec->t_idle;
-            cs += psa.t_idle;
-            psa.t_msg_retrieve = psa_sec->t_msg_retrieve;
-            cs += psa.t_msg_retrieve;
-            psa.interrupt_status = psa_sec->interrupt_status;
-            cs += psa.interrupt_status;
-            psa.ts_psa = psa_sec->ts_psa;
-
-        } while(psa.cs != cs);
-        psas->core_temp = psa.core_temp;
-        psas->idle = psa.idle;
-        psas->retrieved = psa.retrieved;
-        psas->t_active = psa.t_active;
-        psas->t_idle = psa.t_idle;
-        psas->t_msg_retrieve = psa.t_msg_retrieve;
-        psas->interrupt_status = psa.interrupt_status;
-        psas->ts_psa = psa.ts_psa;
-        psas->cs = psa.cs;
+            seq = _psa_read_begin(corenum);
+            *psas = _psa_sec[corenum];
+        } while (_psa_read_retry(corenum, seq));
     }
 }
 
-int cmt_sched_msg_waiting() {
-    int count = 0;
-    uint32_t flags = save_and_disable_interrupts();
-    mutex_enter_blocking(&sm_mutex);
-    for (int i = 0; i < SCHEDULED_MESSAGES_MAX; i++) {
-        _scheduled_msg_data_t* smd = &_scheduled_message_datas[i];
-        if (_SMD_FREE_INDICATOR != smd->remaining) {
-            count++;
-        }
+int cmt_proc_status_history(uint8_t corenum, cmt_ps_sample_t* samples, int max) {
+    if (corenum > 1 || max <= 0) {
+        return (0);
     }
-    mutex_exit(&sm_mutex);
-    restore_interrupts(flags);
+    const _ps_history_t* history = &_ps_history[corenum];
+    uint32_t count;
+    uint32_t seq;
+    do {
+        seq = _psa_read_begin(corenum);
+        uint32_t total = history->count;
+        count = (total < CMT_PS_HISTORY_SECS ? total : CMT_PS_HISTORY_SECS);
+        if (count > (uint32_t)max) {
+            count = max;    // Keep the newest
+        }
+        uint32_t first = total - count;
+        for (uint32_t i = 0; i < count; i++) {
+            samples[i] = history->samples[(first + i) % CMT_PS_HISTORY_SECS];
+        }
+    } while (_psa_read_retry(corenum, seq));
+
+    return ((int)count);
+}
+
+int cmt_sched_msg_waiting() {
+    uint32_t flags = spin_lock_blocking(_sm_lock);
+    int count = _sm_heap_count;
+    spin_unlock(_sm_lock, flags);
 
     return (count);
 }
 
 bool cmt_sched_msg_waiting_ids(int max, uint16_t *buf) {
     bool msgs_waiting = false;
-    int values_num = (max > SCHEDULED_MESSAGES_MAX ? SCHEDULED_MESSAGES_MAX : max);
     int values_index = 0;
-    buf[0] = -1; // Put a '-1' in to indicate the end
-    uint32_t flags = save_and_disable_interrupts();
-    mutex_enter_blocking(&sm_mutex);
-    for (int i = 0; i < values_num; i++) {
-        _scheduled_msg_data_t* smd = &_scheduled_message_datas[i];
-        if (_SMD_FREE_INDICATOR != smd->remaining) {
-            msgs_waiting = true;
-            buf[values_index] = smd->client_msg->id;
-            values_index++;
-        }
-        // If we are less than the 'max' put a '-1' in to indicate the end.
-        if (i+1 < max) {
-            buf[i+1] = -1;
-        }
+    uint32_t flags = spin_lock_blocking(_sm_lock);
+    for (int i = 0; i < _sm_heap_count && values_index < max; i++) {
+        msgs_waiting = true;
+        buf[values_index++] = _sm_heap[i]->client_msg->id;
+    }
+    spin_unlock(_sm_lock, flags);
+    // If we are less than the 'max' put a '-1' in to indicate the end.
+    if (values_index < max) {
+        buf[values_index] = -1;
     }
-    mutex_exit(&sm_mutex);
-    restore_interrupts(flags);
 
     return (msgs_waiting);
 }
 
 void cmt_sleep_ms(int32_t ms, cmt_sleep_fn sleep_fn, void* user_data) {
-    bool scheduled = false;
-
     uint8_t core_num = (uint8_t)get_core_num();
-    uint32_t flags = save_and_disable_interrupts();
-    mutex_enter_blocking(&sm_mutex);
+    uint32_t flags;
     // Get a free smd
-    for (int i = 0; i < SCHEDULED_MESSAGES_MAX; i++) {
-        _scheduled_msg_data_t* smd = &_scheduled_message_datas[i];
-        if (_SMD_FREE_INDICATOR == smd->remaining) {
-            // This is free;
-            smd->sleep_msg.id = MSG_CMT_SLEEP;
-            smd->sleep_msg.data.cmt_sleep.sleep_fn = sleep_fn;
-            smd->sleep_msg.data.cmt_sleep.user_data = user_data;
-            smd->client_msg = &smd->sleep_msg;
-            smd->ms_requested = ms;
-            smd->corenum = core_num;
-            smd->remaining = ms;
-            scheduled = true;
-            break;
-        }
+    _scheduled_msg_data_t* smd = _smd_alloc(&flags);
+    if (smd) {
+        smd->sleep_msg.id = MSG_CMT_SLEEP;
+        smd->sleep_msg.data.cmt_sleep.sleep_fn = sleep_fn;
+        smd->sleep_msg.data.cmt_sleep.user_data = user_data;
+        _smd_schedule(smd, core_num, ms, &smd->sleep_msg);
     }
-    mutex_exit(&sm_mutex);
-    restore_interrupts(flags);
-    if (!scheduled) {
-        panic("CMT - No SMD available for use for sleep.");
+    spin_unlock(_sm_lock, flags);
+    if (!smd) {
+        panic("CMT - No SMD available for use for sleep (pool limit %d).", SCHEDULED_MESSAGES_LIMIT);
     }
 }
 
-void _schedule_core_msg_in_ms(uint8_t core_num, int32_t ms, const cmt_msg_t* msg) {
-    bool scheduled = false;
-    uint32_t flags = save_and_disable_interrupts();
-    mutex_enter_blocking(&sm_mutex);
+/*
+ * Post a message that must be delivered (a call completion) from thread mode. If it
+ * can't be posted now, a copy is scheduled, and the scheduler keeps trying to post it.
+ */
+static void _post_to_core_assured(uint8_t corenum, const cmt_msg_t* msg) {
+    if (_post_to_core_blocking(corenum, msg)) {
+        return;
+    }
+    uint32_t flags;
+    _scheduled_msg_data_t* smd = _smd_alloc(&flags);
+    if (smd) {
+        smd->sleep_msg = *msg;  // The scheduler posts from the block's own copy
+        _smd_schedule(smd, corenum, CMT_POST_RETRY_MS, &smd->sleep_msg);
+    }
+    spin_unlock(_sm_lock, flags);
+    if (!smd) {
+        panic("CMT - No SM Data slot available to retry a post (pool limit %d).", SCHEDULED_MESSAGES_LIMIT);
+    }
+}
+
+static cmt_handle_t _schedule_core_msg(uint8_t core_num, int32_t ms, int32_t period_ms, const cmt_msg_t* msg) {
+    cmt_handle_t handle = CMT_HANDLE_INVALID;
+    uint32_t flags;
     // Get a free smd
-    for (int i = 0; i < SCHEDULED_MESSAGES_MAX; i++) {
-        _scheduled_msg_data_t* smd = &_scheduled_message_datas[i];
-        if (_SMD_FREE_INDICATOR == smd->remaining) {
-            // This is free;
-            smd->client_msg = msg;
-            smd->ms_requested = ms;
-            smd->corenum = core_num;
-            smd->remaining = ms;
-            scheduled = true;
-            break;
+    _scheduled_msg_data_t* smd = _smd_alloc(&flags);
+    if (smd) {
+        smd->period_us = (period_ms > 0 ? (uint32_t)period_ms * 1000 : 0);
+        _smd_schedule(smd, core_num, ms, msg);
+        handle = _smd_handle(smd);
+    }
+    spin_unlock(_sm_lock, flags);
+    if (!smd) {
+        panic("CMT - No SM Data slot available for use (pool limit %d).", SCHEDULED_MESSAGES_LIMIT);
+    }
+    return (handle);
+}
+
+void _schedule_core_msg_in_ms(uint8_t core_num, int32_t ms, const cmt_msg_t* msg) {
+    _schedule_core_msg(core_num, ms, 0, msg);
+}
+
+cmt_handle_t cmt_schedule_msg_in_ms(uint8_t corenum, int32_t ms, const cmt_msg_t* msg) {
+    return (_schedule_core_msg(corenum, ms, 0, msg));
+}
+
+cmt_handle_t cmt_schedule_periodic(uint8_t corenum, int32_t first_ms, int32_t period_ms, const cmt_msg_t* msg) {
+    if (period_ms <= 0) {
+        return (CMT_HANDLE_INVALID);
+    }
+    return (_schedule_core_msg(corenum, first_ms, period_ms, msg));
+}
+
+bool cmt_cancel(cmt_handle_t handle) {
+    uint32_t flags = spin_lock_blocking(_sm_lock);
+    _scheduled_msg_data_t* smd = _smd_for_handle(handle);
+    if (smd) {
+        bool top_removed = (smd->heap_index == 0);
+        _smd_unschedule(smd);
+        if (top_removed) {
+            _sm_alarm_arm();
+        }
+    }
+    spin_unlock(_sm_lock, flags);
+
+    return (NULL != smd);
+}
+
+bool cmt_reschedule(cmt_handle_t handle, int32_t ms) {
+    uint32_t flags = spin_lock_blocking(_sm_lock);
+    _scheduled_msg_data_t* smd = _smd_for_handle(handle);
+    if (smd) {
+        // Take it out and put it back in with the new deadline (the periodic phase restarts from here).
+        _sm_heap_remove(smd);
+        smd->ms_requested = ms;
+        smd->deadline = time_us_64() + ((uint64_t)(ms > 0 ? ms : 0) * 1000);
+        _sm_heap_insert(smd);
+        _sm_alarm_arm();
+    }
+    spin_unlock(_sm_lock, flags);
+
+    return (NULL != smd);
+}
+
+/**
+ * @brief Find the debounce/throttle window for a message ID to a core (must be called with the `_sm_lock` held).
+ *
+ * Only windows opened by `_sm_gate` match, not messages scheduled with the same ID.
+ */
+static _scheduled_msg_data_t* _smd_find(int id_index, uint8_t corenum) {
+    _scheduled_msg_data_t* smd = _sm_id_lists[id_index];
+    while (smd && !(smd->gate && smd->corenum == corenum)) {
+        smd = smd->next;
+    }
+    return (smd);
+}
+
+/*
+ * Debounce/throttle a message to the calling core. If a window for the message ID is
+ * open, the call is merged into it (`restart` restarts the window - debounce). If not,
+ * a window is opened. For `leading` the message is posted now, and the window is a
+ * guard that posts nothing. Otherwise the message is posted when the window closes.
+ *
+ * From an IRQ, this doesn't wait or panic. The leading post doesn't wait (if it can't
+ * be posted, the window is closed again so the next call tries again), and if no
+ * block is available it returns false.
+ *
+ * Returns true if a window was opened (and for `leading`, the message was posted).
+ */
+static bool _sm_gate(const cmt_msg_t* msg, int32_t ms, bool restart, bool leading) {
+    uint8_t corenum = (uint8_t)get_core_num();
+    int id_index = cmt_msg_id_index(msg->id);
+    if (MSG_ID_INDEX_NONE == id_index) {
+        panic("CMT - Debounce/throttle of an out of range message ID: %04x", msg->id);
+    }
+    uint32_t flags = spin_lock_blocking(_sm_lock);
+    _scheduled_msg_data_t* smd = _smd_find(id_index, corenum);
+    if (!smd) {
+        // Get a block and check again (another caller could have opened a window meanwhile).
+        spin_unlock(_sm_lock, flags);
+        _scheduled_msg_data_t* new_smd = _smd_alloc(&flags);
+        smd = _smd_find(id_index, corenum);
+        if (!smd) {
+            if (!new_smd) {
+                spin_unlock(_sm_lock, flags);
+                if (0 != __get_current_exception()) {
+                    return (false);
+                }
+                panic("CMT - No SM Data slot available for use (pool limit %d).", SCHEDULED_MESSAGES_LIMIT);
+            }
+            new_smd->gate = true;
+            new_smd->guard = leading;
+            _smd_schedule(new_smd, corenum, ms, msg);
+            cmt_handle_t handle = _smd_handle(new_smd);
+            spin_unlock(_sm_lock, flags);
+            if (leading && !(0 == corenum ? post_to_core0_nowait(msg) : post_to_core1_nowait(msg))) {
+                cmt_cancel(handle);
+                return (false);
+            }
+            return (true);
+        }
+        if (new_smd) {
+            _smd_free(new_smd);
         }
     }
-    mutex_exit(&sm_mutex);
-    restore_interrupts(flags);
-    if (!scheduled) {
-        panic("CMT - No SM Data slot available for use.");
+    if (restart) {
+        _sm_heap_remove(smd);
+        smd->ms_requested = ms;
+        smd->deadline = time_us_64() + ((uint64_t)(ms > 0 ? ms : 0) * 1000);
+        _sm_heap_insert(smd);
+        _sm_alarm_arm();
     }
+    spin_unlock(_sm_lock, flags);
+
+    return (false);
+}
+
+bool cmt_debounce(const cmt_msg_t* msg, int32_t ms) {
+    return (_sm_gate(msg, ms, true, false));
+}
+
+bool cmt_debounce_leading(const cmt_msg_t* msg, int32_t ms) {
+    return (_sm_gate(msg, ms, true, true));
+}
+
+bool cmt_throttle(const cmt_msg_t* msg, int32_t ms) {
+    return (_sm_gate(msg, ms, false, true));
+}
+
+bool cmt_throttle_trailing(const cmt_msg_t* msg, int32_t ms) {
+    return (_sm_gate(msg, ms, false, false));
 }
 
 void schedule_core0_msg_in_ms(int32_t ms, const cmt_msg_t* msg) {
@@ -254,34 +806,334 @@ void schedule_msg_in_ms(int32_t ms, const cmt_msg_t* msg) {
 }
 
 void scheduled_msg_cancel(msg_id_t sched_msg_id) {
-    uint32_t flags = save_and_disable_interrupts();
-    mutex_enter_blocking(&sm_mutex);
-    for (int i = 0; i < SCHEDULED_MESSAGES_MAX; i++) {
-        _scheduled_msg_data_t* smd = &_scheduled_message_datas[i];
-        if (smd->remaining != _SMD_FREE_INDICATOR && smd->client_msg && smd->client_msg->id == sched_msg_id) {
-            // This matches, so set the remaining to -1;
-            smd->remaining = _SMD_FREE_INDICATOR;
-        }
+    int id_index = cmt_msg_id_index(sched_msg_id);
+    if (MSG_ID_INDEX_NONE == id_index) {
+        return;
+    }
+    uint32_t flags = spin_lock_blocking(_sm_lock);
+    bool top_removed = false;
+    _scheduled_msg_data_t* smd;
+    while (NULL != (smd = _sm_id_lists[id_index])) {
+        // Remove it from the schedule (this also removes it from the ID list).
+        top_removed |= (smd->heap_index == 0);
+        _smd_unschedule(smd);
     }
-    mutex_exit(&sm_mutex);
-    restore_interrupts(flags);
+    if (top_removed) {
+        _sm_alarm_arm();
+    }
+    spin_unlock(_sm_lock, flags);
 }
 
 extern bool scheduled_message_exists(msg_id_t sched_msg_id) {
-    bool exists = false;
-    uint32_t flags = save_and_disable_interrupts();
-    mutex_enter_blocking(&sm_mutex);
-    for (int i = 0; i < SCHEDULED_MESSAGES_MAX; i++) {
-        _scheduled_msg_data_t* smd = &_scheduled_message_datas[i];
-        if (smd->remaining != _SMD_FREE_INDICATOR && smd->client_msg && smd->client_msg->id == sched_msg_id) {
-            // This matches
-            exists = true;
-            break;
+    int id_index = cmt_msg_id_index(sched_msg_id);
+    if (MSG_ID_INDEX_NONE == id_index) {
+        return (false);
+    }
+    // A single pointer read doesn't need the lock.
+    return (NULL != *(_scheduled_msg_data_t* volatile*)&_sm_id_lists[id_index]);
+}
+
+void cmt_sched_msg_pool_status(int* capacity, int* high_water) {
+    uint32_t flags = spin_lock_blocking(_sm_lock);
+    *capacity = _sm_pool_capacity;
+    *high_water = _sm_heap_high_water;
+    spin_unlock(_sm_lock, flags);
+}
+
+/*
+ * Set up the subscriber lists and histograms for both cores (with no subscribers).
+ */
+static void _subs_init() {
+    for (int corenum = 0; corenum < 2; corenum++) {
+        for (int n = 0; n < CMT_DISPATCH_HANDLERS_MAX; n++) {
+            _subs[corenum][n].live = false;
+            _subs[corenum][n].next = (n + 1 < CMT_DISPATCH_HANDLERS_MAX ? n + 1 : _SUB_NONE);
+        }
+        _sub_free[corenum] = 0;
+        _sub_removed[corenum] = 0;
+        memset(_sub_first[corenum], _SUB_NONE, sizeof(_sub_first[corenum]));
+        memset(_msg_hist_num[corenum], _MSG_HIST_NONE, sizeof(_msg_hist_num[corenum]));
+        _msg_hists_count[corenum] = 0;
+        _app_subs[corenum] = NULL;
+    }
+}
+
+/*
+ * Put the removed subscribers back on the free list. Called by the loop when it
+ * isn't dispatching.
+ */
+static void _subs_reclaim(uint8_t corenum) {
+    for (int n = 0; n < CMT_DISPATCH_HANDLERS_MAX; n++) {
+        _cmt_sub_t* sub = &_subs[corenum][n];
+        if (!sub->live && (sub->handler || sub->subscriber)) {
+            sub->handler = NULL;
+            sub->subscriber = NULL;
+            sub->next = _sub_free[corenum];
+            _sub_free[corenum] = (uint8_t)n;
+        }
+    }
+    _sub_removed[corenum] = 0;
+}
+
+static void _subs_core_check(uint8_t corenum) {
+    bool running = (corenum == 0 ? _msg_loop_0_running : _msg_loop_1_running);
+    if (corenum > 1 || (running && corenum != get_core_num())) {
+        panic("CMT - Subscriptions for core %d changed from core %d.", corenum, get_core_num());
+    }
+}
+
+/*
+ * Add a subscriber to the end of an ID's list (in `first`). Also sets up a histogram
+ * for the ID (the first time it has a subscriber).
+ */
+static bool _sub_add(uint8_t corenum, uint8_t* first, msg_id_t msg_id, msg_handler_fn handler, cmt_subscriber_fn subscriber, void* ctx, uint32_t budget_us) {
+    int id_index = cmt_msg_id_index(msg_id);
+    uint8_t n = _sub_free[corenum];
+    if (MSG_ID_INDEX_NONE == id_index || _SUB_NONE == n) {
+        return (false);
+    }
+    _cmt_sub_t* sub = &_subs[corenum][n];
+    _sub_free[corenum] = sub->next;
+    sub->handler = handler;
+    sub->subscriber = subscriber;
+    sub->ctx = ctx;
+    sub->budget_us = (budget_us ? budget_us : CMT_HANDLER_BUDGET_US);
+    sub->next = _SUB_NONE;
+    sub->live = true;
+    uint8_t* np = &first[id_index];
+    while (_SUB_NONE != *np) {
+        np = &_subs[corenum][*np].next;
+    }
+    *np = n;
+    if (_MSG_HIST_NONE == _msg_hist_num[corenum][id_index] && _msg_hists_count[corenum] < CMT_DISPATCH_HANDLERS_MAX) {
+        int h = _msg_hists_count[corenum];
+        cmt_msg_hist_t* hist = &_msg_hists[corenum][h];
+        memset(hist, 0, sizeof(cmt_msg_hist_t));
+        hist->msg_id = (uint16_t)msg_id;
+        _msg_hist_num[corenum][id_index] = (uint8_t)h;
+        _msg_hists_count[corenum] = h + 1;
+    }
+    return (true);
+}
+
+/*
+ * Add the subscribers for a core's NULL terminated list of handler entries.
+ * Multiple handlers for an ID are kept in the order they appear in the list.
+ */
+static void _subs_add_entries(uint8_t corenum, const msg_handler_entry_t** handler_entries) {
+    for (const msg_handler_entry_t** hep = handler_entries; *hep; hep++) {
+        if (MSG_ID_INDEX_NONE == cmt_msg_id_index((msg_id_t)(*hep)->msg_id)) {
+            panic("CMT - Handler registered for an out of range message ID: %04x", (*hep)->msg_id);
+        }
+        if (!_sub_add(corenum, _sub_first[corenum], (msg_id_t)(*hep)->msg_id, (*hep)->msg_handler, NULL, NULL, (*hep)->budget_us)) {
+            panic("CMT - Too many message handlers for core %d (max %d).", corenum, CMT_DISPATCH_HANDLERS_MAX);
+        }
+    }
+}
+
+bool cmt_subscribe(uint8_t corenum, msg_id_t msg_id, cmt_subscriber_fn fn, void* ctx) {
+    _subs_core_check(corenum);
+    return (_sub_add(corenum, _sub_first[corenum], msg_id, NULL, fn, ctx, 0));
+}
+
+bool cmt_unsubscribe(uint8_t corenum, msg_id_t msg_id, cmt_subscriber_fn fn, void* ctx) {
+    _subs_core_check(corenum);
+    int id_index = cmt_msg_id_index(msg_id);
+    if (MSG_ID_INDEX_NONE == id_index) {
+        return (false);
+    }
+    uint8_t* np = &_sub_first[corenum][id_index];
+    while (_SUB_NONE != *np) {
+        _cmt_sub_t* sub = &_subs[corenum][*np];
+        if (sub->subscriber == fn && sub->ctx == ctx) {
+            // Unlink it, but leave its `next` until it is reclaimed.
+            *np = sub->next;
+            sub->live = false;
+            _sub_removed[corenum]++;
+            return (true);
+        }
+        np = &sub->next;
+    }
+    return (false);
+}
+
+void cmt_app_subs_init(cmt_app_subs_t* app, uint8_t corenum) {
+    app->corenum = corenum;
+    memset(app->first, _SUB_NONE, sizeof(app->first));
+}
+
+bool cmt_app_subscribe(cmt_app_subs_t* app, msg_id_t msg_id, cmt_subscriber_fn fn, void* ctx) {
+    _subs_core_check(app->corenum);
+    return (_sub_add(app->corenum, app->first, msg_id, NULL, fn, ctx, 0));
+}
+
+cmt_app_subs_t* cmt_app_activate(uint8_t corenum, cmt_app_subs_t* app) {
+    _subs_core_check(corenum);
+    cmt_app_subs_t* was = _app_subs[corenum];
+    _app_subs[corenum] = app;
+    return (was);
+}
+
+static inline int _msg_hist_bucket(uint32_t us) {
+    // Bucket `b` is for times < 2^b (and >= 2^(b-1))
+    int b = (us ? 32 - __builtin_clz(us) : 0);
+    return (b < CMT_HIST_BUCKETS ? b : CMT_HIST_BUCKETS - 1);
+}
+
+static inline void _msg_hist_count(uint16_t* counts, uint32_t us) {
+    uint16_t* count = &counts[_msg_hist_bucket(us)];
+    if (*count < UINT16_MAX) {
+        (*count)++;
+    }
+}
+
+static void _msg_hist_record(uint8_t corenum, int id_index, uint32_t wait_us, uint32_t handler_us) {
+    uint8_t n = _msg_hist_num[corenum][id_index];
+    if (_MSG_HIST_NONE != n) {
+        cmt_msg_hist_t* hist = &_msg_hists[corenum][n];
+        _msg_hist_count(hist->wait, wait_us);
+        _msg_hist_count(hist->handler, handler_us);
+    }
+}
+
+bool cmt_msg_hist(uint8_t corenum, int n, cmt_msg_hist_t* hist) {
+    if (corenum > 1 || n < 0 || n >= _msg_hists_count[corenum]) {
+        return (false);
+    }
+    // The core may be updating it. It's informational, so a small inconsistency is okay.
+    *hist = _msg_hists[corenum][n];
+    return (true);
+}
+
+void cmt_msg_hist_reset(uint8_t corenum) {
+    if (corenum < 2) {
+        _msg_hists_reset[corenum] = true;
+    }
+}
+
+static void _overrun_record(uint8_t corenum, uint16_t msg_id, void* fn, uint32_t duration_us) {
+    uint32_t n = _overrun_count[corenum];
+    cmt_overrun_t* overrun = &_overruns[corenum][n % CMT_OVERRUNS_MAX];
+    overrun->msg_id = msg_id;
+    overrun->fn = fn;
+    overrun->duration_us = duration_us;
+    overrun->ts_ms = now_ms();
+    _overrun_count[corenum] = n + 1;
+}
+
+int cmt_overruns(uint8_t corenum, cmt_overrun_t* overruns, int max) {
+    if (corenum > 1) {
+        return (0);
+    }
+    // The core may be adding one. It's informational, so a small inconsistency is okay.
+    uint32_t total = _overrun_count[corenum];
+    uint32_t count = (total < CMT_OVERRUNS_MAX ? total : CMT_OVERRUNS_MAX);
+    if (count > (uint32_t)max) {
+        count = max;    // Keep the newest
+    }
+    uint32_t first = total - count;
+    for (uint32_t i = 0; i < count; i++) {
+        overruns[i] = _overruns[corenum][(first + i) % CMT_OVERRUNS_MAX];
+    }
+    return ((int)count);
+}
+
+uint32_t cmt_overrun_count(uint8_t corenum) {
+    return (corenum < 2 ? _overrun_count[corenum] : 0);
+}
+
+bool cmt_crash_record(cmt_crash_record_t* record) {
+    if (_crash_record_valid) {
+        *record = _crash_record;
+    }
+    return (_crash_record_valid);
+}
+
+bool cmt_diag_mode() {
+    return (_diag_mode);
+}
+
+/*
+ * Read the crash record (if any) left in the watchdog scratch registers. A new
+ * record (from the reboot that just happened) puts us in diagnostic mode. The record
+ * is kept (marked as seen) so it can still be reported after later resets.
+ */
+static void _crash_record_check() {
+    uint32_t s0 = watchdog_hw->scratch[0];
+    bool new_record = (_CRASH_MAGIC == (s0 & _CRASH_MAGIC_MASK) && (s0 & _CRASH_NEW));
+    if (!new_record && watchdog_enable_caused_reboot()) {
+        // The hardware watchdog expired without writing a new record (both loops stalled, or
+        // stuck in an interrupt). Replace any record that has already been seen.
+        s0 = _CRASH_MAGIC | _CRASH_NEW | 0xFF;
+        watchdog_hw->scratch[0] = s0;
+        watchdog_hw->scratch[1] = CMT_ACTIVITY_NONE;
+        watchdog_hw->scratch[2] = 0;
+        watchdog_hw->scratch[3] = CMT_WATCHDOG_MS;
+    }
+    if (_CRASH_MAGIC == (s0 & _CRASH_MAGIC_MASK)) {
+        _crash_record.corenum = (uint8_t)(s0 & 0xFF);
+        _crash_record.msg_id = (uint16_t)watchdog_hw->scratch[1];
+        _crash_record.fn = (void*)(uintptr_t)watchdog_hw->scratch[2];
+        _crash_record.stalled_ms = watchdog_hw->scratch[3];
+        _crash_record_valid = true;
+        if (s0 & _CRASH_NEW) {
+            _diag_mode = true;
+            watchdog_hw->scratch[0] = s0 & ~_CRASH_NEW;
+        }
+    }
+}
+
+/*
+ * Called once a second by each loop. Reboot (with a crash record) if the other loop
+ * has stalled, else keep the hardware watchdog from expiring.
+ */
+static void _stall_check(uint8_t corenum, uint32_t now_us) {
+    if (!_watchdog_armed) {
+        return;
+    }
+    uint8_t other = corenum ^ 1;
+    bool other_running = (other == 0 ? _msg_loop_0_running : _msg_loop_1_running);
+    int32_t stalled_us = (int32_t)(now_us - _loop_heartbeat_us[other]);
+    if (other_running && stalled_us > (CMT_STALL_MS * 1000)) {
+        watchdog_hw->scratch[0] = _CRASH_MAGIC | _CRASH_NEW | other;
+        watchdog_hw->scratch[1] = _loop_activity_id[other];
+        watchdog_hw->scratch[2] = (uint32_t)(uintptr_t)_loop_activity_fn[other];
+        watchdog_hw->scratch[3] = (uint32_t)stalled_us / 1000;
+        watchdog_reboot(0, 0, 0);
+        while (true) {
+            tight_loop_contents();
+        }
+    }
+    watchdog_update();
+}
+
+/*
+ * Call the subscribers in a list for a message.
+ */
+static inline void _dispatch_list(uint8_t corenum, uint8_t n, cmt_msg_t* msg, msg_id_t msg_id, uint8_t* count) {
+    _cmt_sub_t* subs = _subs[corenum];
+    while (_SUB_NONE != n) {
+        _cmt_sub_t* sub = &subs[n];
+        if (sub->live) {
+            void* fn = (sub->handler ? (void*)sub->handler : (void*)sub->subscriber);
+            _loop_activity_fn[corenum] = fn;
+            CMT_TRACE_EVENT(CMT_TRACE_HANDLER_ENTER, msg_id, *count);
+            uint32_t run_us = time_us_32();
+            if (sub->handler) {
+                sub->handler(msg);
+            }
+            else {
+                sub->subscriber(msg, sub->ctx);
+            }
+            run_us = time_us_32() - run_us;
+            CMT_TRACE_EVENT(CMT_TRACE_HANDLER_EXIT, msg_id, *count);
+            if (run_us > sub->budget_us) {
+                _overrun_record(corenum, msg_id, fn, run_us);
+            }
+            (*count)++;
         }
+        n = sub->next;
     }
-    mutex_exit(&sm_mutex);
-    restore_interrupts(flags);
-    return (exists);
 }
 
 /*
@@ -293,10 +1145,21 @@ void message_loop(const msg_loop_cntx_t* loop_context) {
     uint8_t corenum = loop_context->corenum;
     get_msg_nowait_fn get_msg_function = (corenum == 0 ? get_core0_msg_nowait : get_core1_msg_nowait);
     cmt_msg_t msg;
-    const idle_fn* idle_functions = loop_context->idle_functions;
+    uint64_t poller_due[CMT_IDLE_POLLERS_MAX];
+    int pollers_num = 0;
+    const idle_poller_entry_t** idle_pollers = loop_context->idle_pollers;
+    while (idle_pollers[pollers_num]) {
+        if (pollers_num >= CMT_IDLE_POLLERS_MAX) {
+            panic("CMT - Too many idle pollers for core %d (max %d).", corenum, CMT_IDLE_POLLERS_MAX);
+        }
+        poller_due[pollers_num++] = 0;
+    }
     proc_status_accum_t *psa = &_psa[corenum];
     proc_status_accum_t *psa_sec = &_psa_sec[corenum];
+    const uint8_t* sub_first = _sub_first[corenum];
+    _subs_add_entries(corenum, loop_context->handler_entries);
     psa->ts_psa = now_ms();
+    _loop_heartbeat_us[corenum] = time_us_32();
 
     // Indicate that the message loop is running for the calling core.
     if (corenum == 0) {
@@ -306,74 +1169,299 @@ void message_loop(const msg_loop_cntx_t* loop_context) {
         _msg_loop_1_running = true;
     }
 
+#if CMT_STALL_MS > 0
+    // Core-0 arms the hardware watchdog (unless we are in diagnostic mode after a stall).
+    if (corenum == 0 && !_diag_mode) {
+        watchdog_enable(CMT_WATCHDOG_MS, true);
+        _watchdog_armed = true;
+    }
+#endif
+
     // Enter into the endless loop reading and dispatching messages to the handlers...
     while (1) {
         uint64_t t_start = now_us();
+        _loop_heartbeat_us[corenum] = (uint32_t)t_start;
+        if (_sub_removed[corenum]) {
+            _subs_reclaim(corenum);
+        }
+        if (_msg_hists_reset[corenum]) {
+            for (int i = 0; i < _msg_hists_count[corenum]; i++) {
+                cmt_msg_hist_t* hist = &_msg_hists[corenum][i];
+                memset(hist->wait, 0, sizeof(hist->wait));
+                memset(hist->handler, 0, sizeof(hist->handler));
+            }
+            _msg_hists_reset[corenum] = false;
+        }
         // Store and reset the process status accumulators once every second
         if (t_start - psa->ts_psa >= ONE_SECOND_US) {
-            int64_t cs = 0;
-            psa_sec->cs = -1;
+            if (0 == corenum) {
+                _core_temp = onboard_temp_c();
+            }
+            float core_temp = _core_temp;
+            uint32_t queue_depth = multicore_depth_peak_take(corenum);
+            uint32_t seq = _psa_seq[corenum];
+            _psa_seq[corenum] = seq + 1;    // Odd - updating
+            __mem_fence_release();
             psa_sec->idle = psa->idle;
-            cs += psa_sec->idle;
             psa->idle = 0;
             psa_sec->retrieved = psa->retrieved;
-            cs += psa_sec->retrieved;
             psa->retrieved = 0;
             psa_sec->t_active = psa->t_active;
-            cs += psa_sec->t_active;
             psa->t_active = 0;
             psa_sec->t_idle = psa->t_idle;
-            cs += psa_sec->t_idle;
             psa->t_idle = 0;
             psa_sec->t_msg_retrieve = psa->t_msg_retrieve;
-            cs += psa_sec->t_msg_retrieve;
             psa->t_msg_retrieve = 0;
+            for (int i = 0; i < CMT_BATCH_BUCKETS; i++) {
+                psa_sec->batches[i] = psa->batches[i];
+                psa->batches[i] = 0;
+            }
             psa_sec->interrupt_status = nvic_hw->iser;
-            cs += psa_sec->interrupt_status;
-            psa_sec->core_temp = onboard_temp_c();
+            psa_sec->core_temp = core_temp;
             psa_sec->ts_psa = t_start;
             psa->ts_psa = t_start;
-            psa_sec->cs = cs;
+            _ps_history_t* history = &_ps_history[corenum];
+            cmt_ps_sample_t* sample = &history->samples[history->count % CMT_PS_HISTORY_SECS];
+            sample->t_active = (uint32_t)psa_sec->t_active;
+            sample->t_idle = (uint32_t)psa_sec->t_idle;
+            sample->t_msg_retrieve = (uint32_t)psa_sec->t_msg_retrieve;
+            sample->retrieved = psa_sec->retrieved;
+            sample->queue_depth = (uint16_t)(queue_depth < UINT16_MAX ? queue_depth : UINT16_MAX);
+            sample->core_temp = core_temp;
+            history->count++;
+            __mem_fence_release();
+            _psa_seq[corenum] = seq + 2;    // Even - consistent
+            // Warn (rate limited) about dropped posts to this core
+            multicore_drops_check(corenum);
+            // Check that the other loop is making progress
+            _stall_check(corenum, (uint32_t)t_start);
+        }
+        // Resume the tasks that are ready (time reached or flag set)
+        uint64_t task_wake_us = UINT64_MAX;
+        if (cmt_tasks_active(corenum)) {
+            _loop_activity_id[corenum] = CMT_ACTIVITY_TASKS;
+            task_wake_us = cmt_tasks_run(corenum, t_start);
+            _loop_activity_id[corenum] = CMT_ACTIVITY_NONE;
+            uint64_t ts = now_us();
+            psa->t_active += ts - t_start;
+            t_start = ts;
         }
 
         if (get_msg_function(&msg)) {
+            // Drain up to a batch of messages, timestamping the batch (rather than each message).
             uint64_t as = now_us();
             psa->t_msg_retrieve += as - t_start;
-            psa->retrieved++;
-            // Find the handler
-            const msg_handler_entry_t** handler_entries = loop_context->handler_entries;
-            while (*handler_entries) {
-                const msg_handler_entry_t* handler_entry = *handler_entries++;
-                if (msg.id == handler_entry->msg_id) {
-                    handler_entry->msg_handler(&msg);
+            int batched = 0;
+            bool more;
+            do {
+                batched++;
+                // Dispatch to the handler(s) for the message ID
+                msg_id_t msg_id = msg.id;   // (a handler could change the message)
+                CMT_TRACE_EVENT(CMT_TRACE_RETRIEVE, msg_id, corenum);
+                int id_index = cmt_msg_id_index(msg_id);
+                if (MSG_ID_INDEX_NONE != id_index) {
+#if CMT_MSG_HISTOGRAMS
+                    uint32_t hs = time_us_32();
+                    uint32_t wait = hs - msg.t;
+#endif
+                    uint8_t count = 0;
+                    _loop_activity_id[corenum] = msg_id;
+                    _dispatch_list(corenum, sub_first[id_index], &msg, msg_id, &count);
+                    cmt_app_subs_t* app = _app_subs[corenum];
+                    if (app) {
+                        _dispatch_list(corenum, app->first[id_index], &msg, msg_id, &count);
+                    }
+                    _loop_activity_id[corenum] = CMT_ACTIVITY_NONE;
+#if CMT_MSG_HISTOGRAMS
+                    _msg_hist_record(corenum, id_index, wait, time_us_32() - hs);
+#endif
                 }
+                // Resume tasks waiting for the message
+                cmt_tasks_msg(corenum, &msg);
+#if CMT_MSG_BATCH_PER_MSG_ACCOUNTING
+                more = false;
+                if (batched < CMT_MSG_BATCH_MAX) {
+                    uint64_t rs = now_us();
+                    more = get_msg_function(&msg);
+                    uint64_t rt = now_us() - rs;
+                    psa->t_msg_retrieve += rt;
+                    as += rt;   // Retrieve time isn't active time
+                }
+#else
+                more = (batched < CMT_MSG_BATCH_MAX && get_msg_function(&msg));
+#endif
+            } while (more);
+            psa->retrieved += batched;
+            int bucket = 0;
+            while (batched > 1 && bucket < CMT_BATCH_BUCKETS - 1) {
+                batched >>= 1;
+                bucket++;
             }
-            // No more handlers found for this message.
+            psa->batches[bucket]++;
             uint64_t ht = now_us() - as;
             psa->t_active += ht;
         }
         else {
-            // No message available, allow next idle function to run
+            // No message available. Run the pollers that are due, then sleep until something
+            // happens (a message post, an interrupt, or the next poller/status update is due).
             uint64_t is = now_us();
             psa->t_msg_retrieve += is - t_start;
             psa->idle++;
-            const idle_fn idle_function = *idle_functions;
-            if (idle_function) {
-                idle_function();
-                idle_functions++; // Next time do the next one...
+            uint64_t wake_us = psa->ts_psa + ONE_SECOND_US;
+            if (task_wake_us < wake_us) {
+                wake_us = task_wake_us;
             }
-            else {
-                // end of function list
-                idle_functions = loop_context->idle_functions; // reset the pointer
+            for (int i = 0; i < pollers_num; i++) {
+                if (is >= poller_due[i]) {
+                    const idle_poller_entry_t* poller = idle_pollers[i];
+                    _loop_activity_id[corenum] = CMT_ACTIVITY_POLLER;
+                    _loop_activity_fn[corenum] = poller->poll_fn;
+                    uint32_t pt = time_us_32();
+                    poller->poll_fn();
+                    pt = time_us_32() - pt;
+                    _loop_activity_id[corenum] = CMT_ACTIVITY_NONE;
+                    if (pt > (poller->budget_us ? poller->budget_us : CMT_HANDLER_BUDGET_US)) {
+                        _overrun_record(corenum, CMT_ACTIVITY_POLLER, poller->poll_fn, pt);
+                    }
+                    poller_due[i] = is + ((uint64_t)poller->period_ms * 1000);
+                }
+                if (poller_due[i] < wake_us) {
+                    wake_us = poller_due[i];
+                }
             }
+#if CMT_IDLE_WFE
+            best_effort_wfe_or_timeout(from_us_since_boot(wake_us));
+#endif
             uint64_t it = now_us() - is;
             psa->t_idle += it;
         }
     }
 }
 
+// ====================================================================
+// Cross-core calls
+// ====================================================================
+
+static inline cmt_call_handle_t _call_handle(const _cmt_call_t* call) {
+    return ((cmt_call_handle_t)((call->generation << 4) | (call - _calls)));
+}
+
+/*
+ * Get the call for a handle (must be called with the `_call_lock` held).
+ */
+static _cmt_call_t* _call_for_handle(cmt_call_handle_t handle) {
+    uint callnum = (handle & 0x0F);
+    if (CMT_CALL_INVALID == handle || callnum >= CMT_CALLS_MAX) {
+        return (NULL);
+    }
+    _cmt_call_t* call = &_calls[callnum];
+    if (_CALL_FREE == call->state || call->generation != (handle >> 4)) {
+        return (NULL);
+    }
+    return (call);
+}
+
+static void _handle_call(cmt_msg_t* msg) {
+    // Run the function if the call hasn't timed out.
+    cmt_call_handle_t handle = msg->data.cmt_call.handle;
+    uint32_t flags = spin_lock_blocking(_call_lock);
+    _cmt_call_t* call = _call_for_handle(handle);
+    bool run = (call && _CALL_PENDING == call->state);
+    if (call && !run) {
+        call->state = _CALL_FREE;   // Timed out before it was run
+    }
+    else if (run) {
+        call->state = _CALL_RUNNING;
+    }
+    spin_unlock(_call_lock, flags);
+    if (!run) {
+        return;
+    }
+    int32_t result = call->fn(call->arg);
+    cmt_cancel(call->timeout_handle);
+    cmt_msg_t cmsg = { call->completion_msg_id };
+    cmsg.data.cmt_call.handle = handle;
+    cmsg.data.cmt_call.status = CMT_CALL_OK;
+    cmsg.data.cmt_call.result = result;
+    uint8_t caller_core = call->caller_core;
+    flags = spin_lock_blocking(_call_lock);
+    bool timedout = (_CALL_TIMEDOUT == call->state);
+    call->state = _CALL_FREE;
+    spin_unlock(_call_lock, flags);
+    if (!timedout) {
+        _post_to_core_assured(caller_core, &cmsg);
+    }
+}
+
+static void _handle_call_timeout(cmt_msg_t* msg) {
+    // The call timed out if it hasn't completed. The called core frees it.
+    cmt_call_handle_t handle = msg->data.cmt_call.handle;
+    cmt_msg_t cmsg;
+    uint32_t flags = spin_lock_blocking(_call_lock);
+    _cmt_call_t* call = _call_for_handle(handle);
+    bool timedout = (call && (_CALL_PENDING == call->state || _CALL_RUNNING == call->state));
+    if (timedout) {
+        call->state = _CALL_TIMEDOUT;
+        cmsg.id = call->completion_msg_id;
+    }
+    spin_unlock(_call_lock, flags);
+    if (timedout) {
+        memset(&cmsg.data, 0, sizeof(cmsg.data));
+        cmsg.data.cmt_call.handle = handle;
+        cmsg.data.cmt_call.status = CMT_CALL_TIMEDOUT;
+        _post_to_core_assured((uint8_t)get_core_num(), &cmsg);
+    }
+}
+
+cmt_call_handle_t cmt_call_on_core(uint8_t corenum, cmt_call_fn fn, void* arg, msg_id_t completion_msg_id, int32_t timeout_ms) {
+    uint8_t caller_core = (uint8_t)get_core_num();
+    _cmt_call_t* call = NULL;
+    uint32_t flags = spin_lock_blocking(_call_lock);
+    for (int i = 0; i < CMT_CALLS_MAX; i++) {
+        if (_CALL_FREE == _calls[i].state) {
+            call = &_calls[i];
+            call->state = _CALL_PENDING;
+            call->generation = (call->generation + 1) & 0x0FFF;
+            if (0 == call->generation) {
+                call->generation = 1;   // Keep the handle from being CMT_CALL_INVALID
+            }
+            break;
+        }
+    }
+    spin_unlock(_call_lock, flags);
+    if (!call) {
+        return (CMT_CALL_INVALID);
+    }
+    cmt_call_handle_t handle = _call_handle(call);
+    call->fn = fn;
+    call->arg = arg;
+    call->completion_msg_id = completion_msg_id;
+    call->caller_core = caller_core;
+    call->timeout_handle = CMT_HANDLE_INVALID;
+    if (timeout_ms > 0) {
+        call->timeout_msg.id = MSG_CMT_CALL_TIMEOUT;
+        memset(&call->timeout_msg.data, 0, sizeof(call->timeout_msg.data));
+        call->timeout_msg.data.cmt_call.handle = handle;
+        call->timeout_handle = cmt_schedule_msg_in_ms(caller_core, timeout_ms, &call->timeout_msg);
+    }
+    cmt_msg_t msg = { MSG_CMT_CALL };
+    msg.data.cmt_call.handle = handle;
+    bool posted = (0 == corenum ? post_to_core0_nowait(&msg) : post_to_core1_nowait(&msg));
+    if (!posted) {
+        cmt_cancel(call->timeout_handle);
+        flags = spin_lock_blocking(_call_lock);
+        call->state = _CALL_FREE;
+        spin_unlock(_call_lock, flags);
+        return (CMT_CALL_INVALID);
+    }
+    return (handle);
+}
+
 void cmt_module_init() {
-    mutex_enter_blocking(&sm_mutex);
+    _crash_record_check();
+    _subs_init();
     _scheduled_msg_init();
-    mutex_exit(&sm_mutex);
+    cmt_alarm_module_init();
+    _call_lock = spin_lock_init(spin_lock_claim_unused(true));
+    memset(_calls, 0, sizeof(_calls));
 }
@@ -22,7 +22,80 @@ extern "C" {
 
 #include "pico/types.h"
 
+/** Number of scheduled message blocks allocated initially */
+#ifndef SCHEDULED_MESSAGES_MAX
 #define SCHEDULED_MESSAGES_MAX 16
+#endif
+/** Number of scheduled message blocks to add when the pool is exhausted */
+#ifndef SCHEDULED_MESSAGES_GROW
+#define SCHEDULED_MESSAGES_GROW 8
+#endif
+/** Maximum number of scheduled message blocks the pool can grow to */
+#ifndef SCHEDULED_MESSAGES_LIMIT
+#define SCHEDULED_MESSAGES_LIMIT 64
+#endif
+/** Time before a scheduled (or CMT internal) message that couldn't be posted is tried again */
+#ifndef CMT_POST_RETRY_MS
+#define CMT_POST_RETRY_MS 1
+#endif
+/** Maximum number of messages the message loop retrieves and dispatches as a batch */
+#ifndef CMT_MSG_BATCH_MAX
+#define CMT_MSG_BATCH_MAX 8
+#endif
+/** Set to 1 to time the retrieval of each message of a batch (rather than once per batch) */
+#ifndef CMT_MSG_BATCH_PER_MSG_ACCOUNTING
+#define CMT_MSG_BATCH_PER_MSG_ACCOUNTING 0
+#endif
+/** Number of batch size buckets (1, 2-3, 4-7, 8-15, ...) in the process status */
+#define CMT_BATCH_BUCKETS 4
+/** Set to 0 to have an idle message loop spin (rather than sleep the core with WFE until an event) */
+#ifndef CMT_IDLE_WFE
+#define CMT_IDLE_WFE 1
+#endif
+/** Maximum number of idle pollers a message loop can have */
+#ifndef CMT_IDLE_POLLERS_MAX
+#define CMT_IDLE_POLLERS_MAX 8
+#endif
+/** Set to 0 to not keep the per message ID wait/handler time histograms (saves the timer reads around each handler - messages are still timestamped when posted, for the lane latency stats) */
+#ifndef CMT_MSG_HISTOGRAMS
+#define CMT_MSG_HISTOGRAMS 1
+#endif
+/** Number of log2 buckets in a message time histogram (bucket `b` counts times < 2^b us, the last is everything else) */
+#define CMT_HIST_BUCKETS 16
+/** Maximum number of cross-core calls (`cmt_call_on_core`) that can be in-flight (16 max) */
+#ifndef CMT_CALLS_MAX
+#define CMT_CALLS_MAX 8
+#endif
+/** Maximum number of handlers/subscribers (total, across all IDs and apps) a message loop can have */
+#ifndef CMT_DISPATCH_HANDLERS_MAX
+#define CMT_DISPATCH_HANDLERS_MAX 48
+#endif
+/** Default execution budget for a handler/poller in microseconds (longer runs are recorded as overruns) */
+#ifndef CMT_HANDLER_BUDGET_US
+#define CMT_HANDLER_BUDGET_US 20000
+#endif
+/** Number of handler overrun records kept for each core (the newest are kept) */
+#ifndef CMT_OVERRUNS_MAX
+#define CMT_OVERRUNS_MAX 8
+#endif
+/** Time in milliseconds a message loop can make no progress before the other core records it and reboots (0 disables) */
+#ifndef CMT_STALL_MS
+#define CMT_STALL_MS 15000
+#endif
+/** Hardware watchdog timeout in milliseconds (for both loops stalling). The RP2040 max is about 8300 */
+#ifndef CMT_WATCHDOG_MS
+#define CMT_WATCHDOG_MS 8000
+#endif
+/** Number of one-second process status samples kept for each core */
+#ifndef CMT_PS_HISTORY_SECS
+#define CMT_PS_HISTORY_SECS 60
+#endif
+/** Activity (in place of a message ID) for running the tasks */
+#define CMT_ACTIVITY_TASKS 0xFFFD
+/** Activity (in place of a message ID) for an idle poller */
+#define CMT_ACTIVITY_POLLER 0xFFFE
+/** Activity (in place of a message ID) for no handler/poller running */
+#define CMT_ACTIVITY_NONE 0xFFFF
 
 typedef enum _MSG_ID_ {
     // Common messages (used by both BE and UI)
@@ -40,6 +113,8 @@ typedef enum _MSG_ID_ {
     MSG_PANEL_REPEAT_21MS,
     MSG_SWITCH_ACTION,
     MSG_SWITCH_LONGPRESS,
+    MSG_CMT_CALL,
+    MSG_CMT_CALL_TIMEOUT,
     //
     // Back-End messages
     MSG_BACKEND_NOOP = 0x0100,
@@ -61,6 +136,44 @@ typedef enum _MSG_ID_ {
     MSG_WIFI_CONN_STATUS_UPDATE,
 } msg_id_t;
 
+/**
+ * @brief Message ID index values.
+ *
+ * The message ID's are partitioned into blocks (Common 0x000, BE 0x100, UI 0x200).
+ * The index packs the blocks together so that tables indexed by message ID
+ * can be dense.
+ */
+#define MSG_ID_BLOCK_SIZE   0x20
+#define MSG_ID_BLOCKS_NUM   3
+#define MSG_ID_INDEX_COUNT  (MSG_ID_BLOCK_SIZE * MSG_ID_BLOCKS_NUM)
+#define MSG_ID_INDEX_NONE   (-1)
+
+/**
+ * @brief Get the dense table index for a message ID.
+ * @ingroup cmt
+ *
+ * @param id The message ID
+ * @return int The index (0 to MSG_ID_INDEX_COUNT-1) or MSG_ID_INDEX_NONE if the ID is out of range.
+ */
+static inline int cmt_msg_id_index(msg_id_t id) {
+    uint block = ((uint)id >> 8);
+    uint offset = ((uint)id & 0xFF);
+    if (block >= MSG_ID_BLOCKS_NUM || offset >= MSG_ID_BLOCK_SIZE) {
+        return (MSG_ID_INDEX_NONE);
+    }
+    return ((int)((block * MSG_ID_BLOCK_SIZE) + offset));
+}
+
+/**
+ * @brief Handle for a scheduled message.
+ * @ingroup cmt
+ *
+ * Opaque value returned when a message is scheduled. It identifies that one
+ * scheduled instance (not all of the scheduled messages with the same ID).
+ */
+typedef uint32_t cmt_handle_t;
+#define CMT_HANDLE_INVALID ((cmt_handle_t)0)
+
 /**
  * @brief Function prototype for a sleep function.
  * @ingroup cmt
@@ -72,6 +185,33 @@ typedef struct _cmt_sleep_data_ {
     void* user_data;
 } cmt_sleep_data_t;
 
+/**
+ * @brief Function prototype for a function called on a core with `cmt_call_on_core`.
+ * @ingroup cmt
+ *
+ * @param arg The argument given to `cmt_call_on_core`.
+ * @return int32_t The result (put in the completion message).
+ */
+typedef int32_t (*cmt_call_fn)(void* arg);
+
+/**
+ * @brief Handle for a cross-core call.
+ * @ingroup cmt
+ */
+typedef uint16_t cmt_call_handle_t;
+#define CMT_CALL_INVALID ((cmt_call_handle_t)0)
+
+typedef enum _CMT_CALL_STATUS_ {
+    CMT_CALL_OK = 0,
+    CMT_CALL_TIMEDOUT,
+} cmt_call_status_t;
+
+typedef struct _cmt_call_data_ {
+    cmt_call_handle_t handle;
+    uint8_t status;                 // cmt_call_status_t
+    int32_t result;
+} cmt_call_data_t;
+
 /**
  * @brief Message data.
  *
@@ -82,6 +222,7 @@ typedef union _MSG_DATA_VALUE {
     bool bv;
     bool debug;
     cmt_sleep_data_t cmt_sleep;
+    cmt_call_data_t cmt_call;
     rc_ir_frame_t ir_frame;
     rc_action_data_t rc_action;
     rc_value_entry_t rc_entry;
@@ -97,7 +238,7 @@ typedef union _MSG_DATA_VALUE {
  *
  * @param id The ID (number) of the message.
  * @param data The data for the message.
- * @param t The millisecond time msg was posted (set by the posting system)
+ * @param t The microsecond time (time_us_32) msg was posted (set by the posting system)
  */
 typedef struct _CMT_MSG {
     msg_id_t id;
@@ -137,24 +278,110 @@ typedef void (*msg_handler_fn)(cmt_msg_t* msg);
 typedef struct _MSG_HANDLER_ENTRY {
     int msg_id;
     msg_handler_fn msg_handler;
+    uint32_t budget_us;         // Execution budget (0 for CMT_HANDLER_BUDGET_US)
 } msg_handler_entry_t;
 
+/**
+ * @brief Function prototype for a message subscriber.
+ * @ingroup cmt
+ *
+ * @param msg The message to handle.
+ * @param ctx The context value given when subscribing.
+ */
+typedef void (*cmt_subscriber_fn)(cmt_msg_t* msg, void* ctx);
+
+/**
+ * @brief A set of subscriptions for an app.
+ * @ingroup cmt
+ *
+ * An app subscribes to the messages it handles once. Only the active app set
+ * (one per core) is dispatched to, so an inactive app has no dispatch cost, and
+ * switching apps is just changing the active set.
+ */
+typedef struct _CMT_APP_SUBS_ {
+    uint8_t corenum;
+    uint8_t first[MSG_ID_INDEX_COUNT];  // First subscriber for each message ID index
+} cmt_app_subs_t;
+
+/**
+ * @brief An idle poller. A function to be called when the message loop is idle,
+ *        no more often than every `period_ms`.
+ * @ingroup cmt
+ *
+ * A period of 0 has the function called every time the loop is idle (which
+ * keeps the core from sleeping).
+ */
+typedef struct _IDLE_POLLER_ENTRY {
+    idle_fn poll_fn;
+    uint32_t period_ms;
+    uint32_t budget_us;         // Execution budget (0 for CMT_HANDLER_BUDGET_US)
+} idle_poller_entry_t;
+
+/**
+ * @brief A handler/poller run that went over its budget.
+ * @ingroup cmt
+ */
+typedef struct _CMT_OVERRUN_ {
+    uint16_t msg_id;            // The message ID (or CMT_ACTIVITY_POLLER)
+    void* fn;                   // The handler/poller function
+    uint32_t duration_us;
+    uint32_t ts_ms;             // When it ended
+} cmt_overrun_t;
+
+/**
+ * @brief Record of a message loop stall, kept in the watchdog scratch registers
+ *      through the reboot.
+ * @ingroup cmt
+ */
+typedef struct _CMT_CRASH_RECORD_ {
+    uint8_t corenum;            // The core that stalled (0xFF if unknown - the hardware watchdog expired)
+    uint16_t msg_id;            // The message ID being handled (or a CMT_ACTIVITY_ value)
+    void* fn;                   // The handler/poller function being run
+    uint32_t stalled_ms;        // How long the loop had made no progress
+} cmt_crash_record_t;
+
+/**
+ * @brief Wait (post to dispatch) and handler time histograms for a message ID.
+ * @ingroup cmt
+ *
+ * Bucket `b` counts times from 2^(b-1) to less than 2^b microseconds (bucket 0 is 0us).
+ * The last bucket counts everything longer. The counts stop at 65535.
+ */
+typedef struct _MSG_ID_HIST_ {
+    uint16_t msg_id;
+    uint16_t wait[CMT_HIST_BUCKETS];
+    uint16_t handler[CMT_HIST_BUCKETS];
+} cmt_msg_hist_t;
+
 typedef struct _PROC_STATUS_ACCUM_ {
-    volatile int64_t cs;
     volatile uint64_t ts_psa;                       // Timestamp of last PS Accumulator/sec update
     volatile uint64_t t_active;
     volatile uint64_t t_idle;
     volatile uint64_t t_msg_retrieve;
     volatile uint32_t retrieved;
-    volatile uint32_t idle;
+    volatile uint32_t idle;                         // Times the loop was idle (woke with no message)
     volatile uint32_t interrupt_status;
+    volatile uint32_t batches[CMT_BATCH_BUCKETS];   // Number of message batches by size (1, 2-3, 4-7, 8+)
     volatile float core_temp;
 } proc_status_accum_t;
 
+/**
+ * @brief A one-second process status sample (for seeing the load trend).
+ * @ingroup cmt
+ */
+typedef struct _PROC_STATUS_SAMPLE_ {
+    uint32_t t_active;          // Microseconds active in the second
+    uint32_t t_idle;            // Microseconds idle in the second
+    uint32_t t_msg_retrieve;    // Microseconds retrieving messages in the second
+    uint32_t retrieved;         // Messages retrieved in the second
+    uint16_t queue_depth;       // Most messages waiting in a lane during the second
+    float core_temp;
+} cmt_ps_sample_t;
+
 typedef struct _MSG_LOOP_CNTX {
     uint8_t corenum;                                // The core number the loop is running on
-    const msg_handler_entry_t** handler_entries;    // NULL terminated list of message handler entries
-    const idle_fn* idle_functions;                  // Null terminated list of idle functions
+    const msg_handler_entry_t** handler_entries;    // NULL terminated list of message handler entries (order only matters for multiple handlers of an ID)
+    const idle_poller_entry_t** idle_pollers;       // NULL terminated list of idle poller entries
 } msg_loop_cntx_t;
 
 /**
@@ -165,6 +392,15 @@ typedef struct _MSG_LOOP_CNTX {
  */
 extern const msg_handler_entry_t cmt_sm_tick_handler_entry;
 
+/**
+ * @brief Handler Entries for cross-core calls. These are put in both message loop
+ *      handler lists, so either core can be called (and receive a timeout).
+ * @ingroup cmt
+ *
+ */
+extern const msg_handler_entry_t cmt_call_handler_entry;
+extern const msg_handler_entry_t cmt_call_timeout_handler_entry;
+
 
 /**
  * @brief Indicates if the Core-0 message loop has been started.
@@ -208,6 +444,19 @@ extern void cmt_handle_sleep(cmt_msg_t* msg);
  */
 extern void cmt_proc_status_sec(proc_status_accum_t* psas, uint8_t corenum);
 
+/**
+ * @brief Get the last one-second process status samples for a core (oldest first).
+ * @ingroup cmt
+ *
+ * Up to CMT_PS_HISTORY_SECS samples are kept.
+ *
+ * @param corenum The core number (0|1).
+ * @param samples Buffer for the samples.
+ * @param max The size of the buffer (number of samples).
+ * @return int The number of samples copied.
+ */
+extern int cmt_proc_status_history(uint8_t corenum, cmt_ps_sample_t* samples, int max);
+
 /**
  * @brief The number of scheduled messages waiting.
  *
@@ -215,6 +464,14 @@ extern void cmt_proc_status_sec(proc_status_accum_t* psas, uint8_t corenum);
  */
 extern int cmt_sched_msg_waiting();
 
+/**
+ * @brief Get the scheduled message pool status.
+ *
+ * @param capacity Pointer to an int to receive the number of blocks in the pool.
+ * @param high_water Pointer to an int to receive the maximum number of messages that have been scheduled at one time.
+ */
+extern void cmt_sched_msg_pool_status(int* capacity, int* high_water);
+
 /**
  * @brief Get the ID's of the scheduled messages waiting.
  *
@@ -225,6 +482,162 @@ extern int cmt_sched_msg_waiting();
  */
 extern bool cmt_sched_msg_waiting_ids(int max, uint16_t *buf);
 
+/**
+ * @brief Get the wait/handler time histogram for a message ID handled by a core.
+ * @ingroup cmt
+ *
+ * There is a histogram for each message ID that the core has handlers for.
+ * Call with `n` from 0 until false is returned to get all of them.
+ *
+ * @param corenum The core number (0|1).
+ * @param n The histogram number.
+ * @param hist Pointer to the histogram to fill in.
+ * @return true The histogram was filled in.
+ * @return false There isn't a histogram `n`.
+ */
+extern bool cmt_msg_hist(uint8_t corenum, int n, cmt_msg_hist_t* hist);
+
+/**
+ * @brief Request that a core's message histograms be reset.
+ * @ingroup cmt
+ *
+ * The reset is done by the core (in its message loop).
+ *
+ * @param corenum The core number (0|1).
+ */
+extern void cmt_msg_hist_reset(uint8_t corenum);
+
+/**
+ * @brief Subscribe to a message ID on a core.
+ * @ingroup cmt
+ *
+ * The subscriber is called (with `ctx`) after the handlers and earlier subscribers
+ * for the ID. This must be called from the core (thread) the subscription is for.
+ *
+ * @param corenum The core number (0|1).
+ * @param msg_id The message ID.
+ * @param fn The subscriber function.
+ * @param ctx Context value passed to the function.
+ * @return true If subscribed.
+ * @return false If the ID is out of range or the core has CMT_DISPATCH_HANDLERS_MAX already.
+ */
+extern bool cmt_subscribe(uint8_t corenum, msg_id_t msg_id, cmt_subscriber_fn fn, void* ctx);
+
+/**
+ * @brief Remove a subscription made with `cmt_subscribe`.
+ * @ingroup cmt
+ *
+ * This can be called from a handler/subscriber (including the one being removed).
+ * Must be called from the core (thread) the subscription is for.
+ *
+ * @param corenum The core number (0|1).
+ * @param msg_id The message ID.
+ * @param fn The subscriber function.
+ * @param ctx The context value it was subscribed with.
+ * @return true If it was found and removed.
+ */
+extern bool cmt_unsubscribe(uint8_t corenum, msg_id_t msg_id, cmt_subscriber_fn fn, void* ctx);
+
+/**
+ * @brief Initialize a set of app subscriptions (with no subscriptions).
+ * @ingroup cmt
+ *
+ * @param app The app subscription set.
+ * @param corenum The core number (0|1) the app runs on.
+ */
+extern void cmt_app_subs_init(cmt_app_subs_t* app, uint8_t corenum);
+
+/**
+ * @brief Add a subscription to an app subscription set.
+ * @ingroup cmt
+ *
+ * Must be called from the core (thread) the app runs on.
+ *
+ * @param app The app subscription set.
+ * @param msg_id The message ID.
+ * @param fn The subscriber function.
+ * @param ctx Context value passed to the function.
+ * @return true If subscribed.
+ * @return false If the ID is out of range or the core has CMT_DISPATCH_HANDLERS_MAX already.
+ */
+extern bool cmt_app_subscribe(cmt_app_subs_t* app, msg_id_t msg_id, cmt_subscriber_fn fn, void* ctx);
+
+/**
+ * @brief Make an app subscription set the active one for its core.
+ * @ingroup cmt
+ *
+ * Must be called from the core (thread) the app runs on.
+ *
+ * @param corenum The core number (0|1).
+ * @param app The app subscription set (or NULL for none).
+ * @return cmt_app_subs_t* The set that was active (or NULL).
+ */
+extern cmt_app_subs_t* cmt_app_activate(uint8_t corenum, cmt_app_subs_t* app);
+
+/**
+ * @brief Get the handler/poller overrun records for a core (oldest first).
+ * @ingroup cmt
+ *
+ * @param corenum The core number (0|1).
+ * @param overruns Buffer for the records.
+ * @param max The size of the buffer (number of records).
+ * @return int The number of records copied.
+ */
+extern int cmt_overruns(uint8_t corenum, cmt_overrun_t* overruns, int max);
+
+/**
+ * @brief The total number of handler/poller overruns for a core.
+ * @ingroup cmt
+ *
+ * @param corenum The core number (0|1).
+ * @return uint32_t The number of overruns since boot.
+ */
+extern uint32_t cmt_overrun_count(uint8_t corenum);
+
+/**
+ * @brief Get the crash record from a stall that caused a reboot.
+ * @ingroup cmt
+ *
+ * @param record Pointer to the record to fill in.
+ * @return true There is a crash record.
+ * @return false There isn't one (normal power-up/reset).
+ */
+extern bool cmt_crash_record(cmt_crash_record_t* record);
+
+/**
+ * @brief Indicates that the system rebooted because of a message loop stall.
+ * @ingroup cmt
+ *
+ * In this diagnostic mode the watchdog isn't armed (so a stall that repeats
+ * doesn't keep rebooting) and the crash record is reported.
+ *
+ * @return true If in diagnostic mode.
+ */
+extern bool cmt_diag_mode();
+
+/**
+ * @brief Call a function on a core's message loop and get the result back as a message.
+ * @ingroup cmt
+ *
+ * The function is run by the message loop of `corenum`. When it returns, a message
+ * with the `completion_msg_id` is posted back to the calling core, with `data.cmt_call`
+ * containing the handle, the status (CMT_CALL_OK), and the result.
+ *
+ * If `timeout_ms` is greater than 0 and the function hasn't completed by then, the
+ * completion message is posted with the status CMT_CALL_TIMEDOUT instead. If the function
+ * hasn't been started, it won't be. If it is running, its result is discarded.
+ * Exactly one completion message is posted for each call.
+ *
+ * @param corenum The core number (0|1) to run the function on.
+ * @param fn The function to run.
+ * @param arg The argument to pass to the function.
+ * @param completion_msg_id The ID of the message to post back to the calling core.
+ * @param timeout_ms Time limit in milliseconds (0 for none).
+ * @return cmt_call_handle_t Handle for the call, or CMT_CALL_INVALID if the maximum number
+ *      of calls are in-flight or the call couldn't be posted.
+ */
+extern cmt_call_handle_t cmt_call_on_core(uint8_t corenum, cmt_call_fn fn, void* arg, msg_id_t completion_msg_id, int32_t timeout_ms);
+
 /**
  * @brief Sleep for milliseconds and call a function.
  * @ingroup cmt
@@ -265,6 +678,119 @@ extern void schedule_core1_msg_in_ms(int32_t ms, const cmt_msg_t* msg);
  */
 extern void schedule_msg_in_ms(int32_t ms, const cmt_msg_t* msg);
 
+/**
+ * @brief Schedule a message to post to a core in the future, returning a handle.
+ * @ingroup cmt
+ *
+ * @param corenum The core (0|1) to post the message to.
+ * @param ms The time in milliseconds from now.
+ * @param msg The cmt_msg_t message to post when the time period elapses.
+ * @return cmt_handle_t Handle that can be used to cancel or reschedule the message.
+ */
+extern cmt_handle_t cmt_schedule_msg_in_ms(uint8_t corenum, int32_t ms, const cmt_msg_t* msg);
+
+/**
+ * @brief Schedule a message to post to a core periodically.
+ * @ingroup cmt
+ *
+ * The deadlines are phase-locked to the first one (each is the previous deadline
+ * plus the period), so the message doesn't drift due to handling latency. If the
+ * system falls more than a period behind, the missed posts are skipped.
+ *
+ * The message is copied each time it is posted, so the data in `msg` can be
+ * changed (for example, by the message handler) to affect the next post.
+ *
+ * @param corenum The core (0|1) to post the message to.
+ * @param first_ms The time in milliseconds from now for the first post.
+ * @param period_ms The period in milliseconds of the posts after the first one (must be > 0).
+ * @param msg The cmt_msg_t message to post. Must remain valid until cancelled.
+ * @return cmt_handle_t Handle that is used to cancel or reschedule the message, or
+ *      CMT_HANDLE_INVALID if `period_ms` isn't greater than 0 (nothing is scheduled).
+ */
+extern cmt_handle_t cmt_schedule_periodic(uint8_t corenum, int32_t first_ms, int32_t period_ms, const cmt_msg_t* msg);
+
+/**
+ * @brief Cancel a scheduled message by its handle.
+ * @ingroup cmt
+ *
+ * @param handle The handle returned when the message was scheduled.
+ * @return true If the message was cancelled.
+ * @return false If the handle isn't scheduled (a one-shot already posted, or already cancelled).
+ */
+extern bool cmt_cancel(cmt_handle_t handle);
+
+/**
+ * @brief Reschedule a scheduled message by its handle.
+ * @ingroup cmt
+ *
+ * The message will post `ms` from now. For a periodic message, the following
+ * posts are phase-locked to this new deadline.
+ *
+ * @param handle The handle returned when the message was scheduled.
+ * @param ms The time in milliseconds from now.
+ * @return true If the message was rescheduled.
+ * @return false If the handle isn't scheduled.
+ */
+extern bool cmt_reschedule(cmt_handle_t handle, int32_t ms);
+
+/**
+ * @brief Debounce a message (trailing edge). Post it to the calling core once
+ *      there have been no calls for `ms`.
+ * @ingroup cmt
+ *
+ * Each call restarts the time. This is atomic (a single look-up in the scheduler),
+ * so it can be called from an IRQ handler. Messages are matched by ID (only with
+ * other debounce/throttle calls, not with messages scheduled by `schedule_msg_in_ms`
+ * etc.), and the message must remain valid until it is posted (like `schedule_msg_in_ms`).
+ *
+ * The debounce and throttle calls don't wait. The leading edge ones post the message
+ * with a 'nowait' post, and return false if it couldn't be posted. From an IRQ, if no
+ * scheduler block is available they return false (from thread mode they panic, like
+ * `schedule_msg_in_ms`).
+ *
+ * @param msg The message.
+ * @param ms The quiet time in milliseconds.
+ * @return true If this started a new debounce (rather than restarting one, or, from
+ *      an IRQ, not getting a scheduler block).
+ */
+extern bool cmt_debounce(const cmt_msg_t* msg, int32_t ms);
+
+/**
+ * @brief Debounce a message (leading edge). Post it to the calling core right away,
+ *      unless it was called within the last `ms` (each call restarts the time).
+ * @ingroup cmt
+ *
+ * @param msg The message.
+ * @param ms The quiet time in milliseconds.
+ * @return true If the message was posted.
+ */
+extern bool cmt_debounce_leading(const cmt_msg_t* msg, int32_t ms);
+
+/**
+ * @brief Throttle a message (leading edge). Post it to the calling core right away,
+ *      unless it was posted within the last `ms`.
+ * @ingroup cmt
+ *
+ * Calls within the time are dropped (they don't extend it).
+ *
+ * @param msg The message.
+ * @param ms The minimum time between posts in milliseconds.
+ * @return true If the message was posted.
+ */
+extern bool cmt_throttle(const cmt_msg_t* msg, int32_t ms);
+
+/**
+ * @brief Throttle a message (trailing edge). Post it to the calling core `ms` after
+ *      the first call. Calls until then are merged into that one post.
+ * @ingroup cmt
+ *
+ * @param msg The message.
+ * @param ms The time in milliseconds.
+ * @return true If this scheduled the message (rather than being merged, or, from
+ *      an IRQ, not getting a scheduler block).
+ */
+extern bool cmt_throttle_trailing(const cmt_msg_t* msg, int32_t ms);
+
 /**
  * @brief Cancel scheduled message(s) for a message ID.
  * @ingroup cmt
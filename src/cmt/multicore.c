@@ -8,144 +8,689 @@
  *
 */
 #include "multicore.h"
+#include "trace.h"
 #include "system_defs.h"
 #include "cmt.h"
 #include "core1_main.h"
 #include "board.h"
 #include "debug_support.h"
 
+#include "hardware/sync.h"
+
 #include <stdio.h>
 #include <string.h>
 
-#define CORE0_QUEUE_ENTRIES_MAX 32
-#define CORE1_QUEUE_ENTRIES_MAX 32
+/*
+ * Inter-core message rings.
+ *
+ * Each core (consumer) has a Single-Producer/Single-Consumer ring for each of
+ * the contexts that can post to it: thread (non-IRQ) mode on core 0 and core 1,
+ * and IRQ mode on core 0 and core 1. Since each ring only ever has one writer
+ * and one reader, no locks (or interrupt disabling) are needed. The producer
+ * writes the slot and then publishes it by advancing `head`. The consumer reads
+ * the slot and then releases it by advancing `tail`. Memory barriers order the
+ * slot access against the index update, and `__sev()` wakes a core that is
+ * waiting (`__wfe()`) for a message or for a free slot.
+ *
+ * There is a set of rings for each priority lane. The consumer empties the
+ * high lane before taking anything from the normal lane.
+ *
+ * Some (idempotent, periodic) messages are 'latest-value-wins'. Rather than
+ * being put in a ring, they are put in a per-core mailbox for their ID. If the
+ * previous one hasn't been retrieved yet it is overwritten (and counted as
+ * coalesced). The mailboxes are part of the normal lane (checked before its rings).
+ *
+ * The rings hold compact (8 byte) messages: a 16-bit ID, a 16-bit payload, and
+ * the 32-bit post time. If a message's data fits in the payload (everything past
+ * the first 2 bytes is zero) it is carried inline. Otherwise the data is copied
+ * into a reference counted slab block and the payload is the block number. A
+ * message posted to both cores shares one block. The consumer holds the block
+ * until it retrieves its next message (the message has been handled by then),
+ * and the block is freed when the last core is done with it.
+ *
+ * The IRQ rings rely on IRQ handlers that post messages not preempting each other
+ * (they all use the default IRQ priority).
+ */
+#define RING_PRODUCER_THREAD_CORE0  0
+#define RING_PRODUCER_THREAD_CORE1  1
+#define RING_PRODUCER_IRQ_CORE0     2
+#define RING_PRODUCER_IRQ_CORE1     3
+#define RING_PRODUCERS_NUM          4
+
+#ifndef CORE_RING_ENTRIES
+#define CORE_RING_ENTRIES 32    // Must be a power of 2
+#endif
+#define CORE_RING_MASK (CORE_RING_ENTRIES - 1)
+
+#define QMSG_SLAB_FLAG      0x8000  // ID flag - The payload is a slab block number
+#define QMSG_INLINE_SIZE    2       // Bytes of data that can be carried inline
+
+typedef struct _QMSG_ {
+    uint16_t id;                // Message ID (with QMSG_SLAB_FLAG if the data is in a slab block)
+    uint16_t payload;           // First 2 bytes of the data, or the slab block number
+    uint32_t t;                 // Time posted (time_us_32)
+} _qmsg_t;
+
+typedef struct _MSG_RING_ {
+    volatile uint32_t head;     // Written only by the producer (free-running)
+    volatile uint32_t tail;     // Written only by the consumer (free-running)
+    volatile uint32_t drops;    // Nowait posts that didn't fit. Written only by the producer.
+    _qmsg_t slots[CORE_RING_ENTRIES];
+} _msg_ring_t;
 
 static bool _initialized = false;
 
-queue_t core0_queue;
-queue_t core1_queue;
+static _msg_ring_t _core_rings[2][MSG_LANES_NUM][RING_PRODUCERS_NUM];  // Rings by consumer core, lane, and producer
+static uint8_t _next_ring[2][MSG_LANES_NUM];    // Ring to check first (for fairness). Consumer only.
+static msg_lane_stats_t _lane_stats[2][MSG_LANES_NUM];  // Updated only by the consumer
+static volatile bool _lane_stats_reset[2];      // Request for the consumer to reset its stats
+static uint32_t _depth_peak[2];                 // Most messages in a lane since last taken (by the consumer)
 
-void get_core0_msg_blocking(cmt_msg_t* msg) {
-    queue_remove_blocking(&core0_queue, msg);
+// Dropped (Nowait) posts by message ID. One set per producer, so each has a single writer.
+static volatile uint32_t _id_drops[RING_PRODUCERS_NUM][MSG_ID_INDEX_COUNT];
+// Drop warning (rate limiting) state. Used only by the consumer.
+#define DROPS_WARN_INTERVAL_MS 5000
+static uint32_t _drops_warned[2];               // Drop total when last warned
+static uint32_t _drops_warn_ts[2];              // Time (ms) last warned
+
+/*
+ * Reference counted message data slab.
+ */
+#ifndef CMT_MSG_SLAB_BLOCKS
+#define CMT_MSG_SLAB_BLOCKS 32
+#endif
+/** Slab blocks kept for blocking and IRQ posts (a thread mode 'nowait' post can't use them) */
+#ifndef CMT_MSG_SLAB_RESERVE
+#define CMT_MSG_SLAB_RESERVE 8
+#endif
+/** Most time a blocking post waits for a slab block (ms), so cores posting to each other can't deadlock */
+#ifndef CMT_MSG_SLAB_WAIT_MS
+#define CMT_MSG_SLAB_WAIT_MS 20
+#endif
+#define SLAB_NONE 0xFF
+
+typedef struct _SLAB_BLOCK_ {
+    msg_data_value_t data;
+    uint16_t msg_id;
+    volatile uint8_t refs;      // Cores that haven't finished with it (0 = free)
+    uint8_t next_free;
+} _slab_block_t;
+
+static spin_lock_t* _slab_lock;
+static _slab_block_t _slab[CMT_MSG_SLAB_BLOCKS];
+static uint8_t _slab_free;                      // First free block (SLAB_NONE if none)
+static int _slab_in_use;
+static int _slab_high_water;
+static uint8_t _held_block[2];                  // Block of the last message retrieved by each core
+static msg_release_fn _release_fns[MSG_ID_INDEX_COUNT];
+
+/*
+ * Latest-value-wins mailboxes.
+ */
+#define MAILBOX_NONE                (-1)
+#define MAILBOX_PANEL_REPEAT_21MS   0
+#define MAILBOX_PANEL_BLINK_FAST    1
+#define MAILBOX_PANEL_BLINK_SLOW    2
+#define MAILBOX_PANEL_TOD_UPDATE    3
+#define MAILBOXES_NUM               4
+
+typedef struct _MSG_MAILBOX_ {
+    cmt_msg_t msg;              // The latest message posted
+} _msg_mailbox_t;
+
+static spin_lock_t* _mailbox_lock;
+static _msg_mailbox_t _mailboxes[2][MAILBOXES_NUM];
+static volatile uint32_t _mailboxes_pending[2];     // Bit per mailbox with a message waiting
+static volatile uint32_t _mailboxes_coalesced[2];   // Posts that overwrote an unretrieved message
+
+static inline int _mailbox_for_id(msg_id_t id) {
+    switch (id) {
+        case MSG_PANEL_REPEAT_21MS:
+            return (MAILBOX_PANEL_REPEAT_21MS);
+        case MSG_PANEL_BLINK_FAST_TGL:
+            return (MAILBOX_PANEL_BLINK_FAST);
+        case MSG_PANEL_BLINK_SLOW_TGL:
+            return (MAILBOX_PANEL_BLINK_SLOW);
+        case MSG_PANEL_TOD_UPDATE:
+            return (MAILBOX_PANEL_TOD_UPDATE);
+        default:
+            return (MAILBOX_NONE);
+    }
 }
 
-bool get_core0_msg_nowait(cmt_msg_t* msg) {
-    register bool retrieved = false;
-    uint32_t flags = save_and_disable_interrupts();
-    retrieved = queue_try_remove(&core0_queue, msg);
-    restore_interrupts(flags);
+static void _mailbox_post(uint8_t corenum, int mbnum, const cmt_msg_t* msg) {
+    _msg_mailbox_t* mb = &_mailboxes[corenum][mbnum];
+    uint32_t mbbit = (1u << mbnum);
+    uint32_t flags = spin_lock_blocking(_mailbox_lock);
+    mb->msg = *msg;
+    mb->msg.t = time_us_32();
+    if (_mailboxes_pending[corenum] & mbbit) {
+        _mailboxes_coalesced[corenum]++;
+    }
+    else {
+        _mailboxes_pending[corenum] |= mbbit;
+    }
+    spin_unlock(_mailbox_lock, flags);
+    CMT_TRACE_EVENT(CMT_TRACE_POST, msg->id, corenum);
+    __sev();                // Wake the consumer if it is waiting
+}
+
+static bool _mailbox_try_remove(uint8_t corenum, cmt_msg_t* msg) {
+    if (0 == _mailboxes_pending[corenum]) {
+        return (false);     // Quick check without the lock
+    }
+    bool retrieved = false;
+    uint32_t flags = spin_lock_blocking(_mailbox_lock);
+    uint32_t pending = _mailboxes_pending[corenum];
+    for (int mbnum = 0; mbnum < MAILBOXES_NUM; mbnum++) {
+        uint32_t mbbit = (1u << mbnum);
+        if (pending & mbbit) {
+            _msg_mailbox_t* mb = &_mailboxes[corenum][mbnum];
+            *msg = mb->msg;
+            _mailboxes_pending[corenum] = pending & ~mbbit;
+            retrieved = true;
+            break;
+        }
+    }
+    spin_unlock(_mailbox_lock, flags);
 
     return (retrieved);
 }
 
+static uint8_t _slab_alloc(const cmt_msg_t* msg, uint8_t refs, bool reserve) {
+    uint32_t flags = spin_lock_blocking(_slab_lock);
+    uint8_t bn = _slab_free;
+    if (!reserve && (CMT_MSG_SLAB_BLOCKS - _slab_in_use) <= CMT_MSG_SLAB_RESERVE) {
+        bn = SLAB_NONE;     // Only the reserve is left
+    }
+    if (SLAB_NONE != bn) {
+        _slab_block_t* block = &_slab[bn];
+        _slab_free = block->next_free;
+        block->refs = refs;
+        if (++_slab_in_use > _slab_high_water) {
+            _slab_high_water = _slab_in_use;
+        }
+    }
+    spin_unlock(_slab_lock, flags);
+    if (SLAB_NONE != bn) {
+        // We own it now, so fill it in outside of the lock.
+        _slab[bn].data = msg->data;
+        _slab[bn].msg_id = (uint16_t)msg->id;
+    }
+    return (bn);
+}
+
+static void _slab_release(uint8_t bn) {
+    _slab_block_t* block = &_slab[bn];
+    uint32_t flags = spin_lock_blocking(_slab_lock);
+    bool last = (0 == --block->refs);
+    spin_unlock(_slab_lock, flags);
+    if (last) {
+        int id_index = cmt_msg_id_index((msg_id_t)block->msg_id);
+        msg_release_fn release_fn = (MSG_ID_INDEX_NONE != id_index ? _release_fns[id_index] : NULL);
+        if (release_fn) {
+            release_fn(&block->data);
+        }
+        flags = spin_lock_blocking(_slab_lock);
+        block->next_free = _slab_free;
+        _slab_free = bn;
+        _slab_in_use--;
+        spin_unlock(_slab_lock, flags);
+        __sev();            // Wake a producer if it is waiting for a block
+    }
+}
+
+static inline bool _data_fits_inline(const msg_data_value_t* data) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (int i = QMSG_INLINE_SIZE; i < sizeof(msg_data_value_t); i++) {
+        if (bytes[i]) {
+            return (false);
+        }
+    }
+    return (true);
+}
+
+/*
+ * Encode a message for the rings. The data goes in a slab block (with `refs` references)
+ * if it doesn't fit inline, or the message ID has a release function. `reserve` allows
+ * the last CMT_MSG_SLAB_RESERVE blocks to be used.
+ * Returns false if a slab block is needed and none are available.
+ */
+static bool _qmsg_encode(const cmt_msg_t* msg, uint8_t refs, bool reserve, _qmsg_t* qmsg) {
+    int id_index = cmt_msg_id_index(msg->id);
+    bool has_release = (MSG_ID_INDEX_NONE != id_index && NULL != _release_fns[id_index]);
+    qmsg->id = (uint16_t)msg->id;
+    if (!has_release && _data_fits_inline(&msg->data)) {
+        memcpy(&qmsg->payload, &msg->data, QMSG_INLINE_SIZE);
+        return (true);
+    }
+    uint8_t bn = _slab_alloc(msg, refs, reserve);
+    if (SLAB_NONE == bn) {
+        return (false);
+    }
+    qmsg->id |= QMSG_SLAB_FLAG;
+    qmsg->payload = bn;
+    return (true);
+}
+
+static void _qmsg_decode(uint8_t corenum, const _qmsg_t* qmsg, cmt_msg_t* msg) {
+    msg->t = qmsg->t;
+    if (qmsg->id & QMSG_SLAB_FLAG) {
+        uint8_t bn = (uint8_t)qmsg->payload;
+        msg->id = (msg_id_t)(qmsg->id & ~QMSG_SLAB_FLAG);
+        msg->data = _slab[bn].data;
+        _held_block[corenum] = bn;  // Released when the next message is retrieved
+    }
+    else {
+        msg->id = (msg_id_t)qmsg->id;
+        memset(&msg->data, 0, sizeof(msg_data_value_t));
+        memcpy(&msg->data, &qmsg->payload, QMSG_INLINE_SIZE);
+    }
+}
+
+static inline uint _ring_level(const _msg_ring_t* ring) {
+    return (ring->head - ring->tail);
+}
+
+msg_lane_t msg_lane_for_id(msg_id_t id) {
+    switch (id) {
+        // User input - get these to the handlers without waiting for housekeeping
+        case MSG_INPUT_SW_PRESS:
+        case MSG_INPUT_SW_RELEASE:
+        case MSG_RC_ACTION:
+        case MSG_RC_LONGPRESS:
+        case MSG_RC_VALUE_ENTERED:
+        case MSG_SWITCH_ACTION:
+        case MSG_SWITCH_LONGPRESS:
+        case MSG_IR_FRAME_RCVD:
+            return (MSG_LANE_HIGH);
+        default:
+            return (MSG_LANE_NORMAL);
+    }
+}
+
+static inline _msg_ring_t* _producer_ring(uint8_t corenum, msg_id_t id) {
+    uint producer = get_core_num();
+    if (0 != __get_current_exception()) {
+        producer += RING_PRODUCER_IRQ_CORE0;
+    }
+    return (&_core_rings[corenum][msg_lane_for_id(id)][producer]);
+}
+
+static bool _ring_try_add(_msg_ring_t* ring, const _qmsg_t* qmsg) {
+    uint32_t head = ring->head;
+    if (head - ring->tail >= CORE_RING_ENTRIES) {
+        return (false); // Full
+    }
+    _qmsg_t* slot = &ring->slots[head & CORE_RING_MASK];
+    slot->id = qmsg->id;
+    slot->payload = qmsg->payload;
+    slot->t = time_us_32();
+    __mem_fence_release();  // Slot contents are visible before the new head
+    ring->head = head + 1;
+    CMT_TRACE_EVENT(CMT_TRACE_POST, (qmsg->id & ~QMSG_SLAB_FLAG), (ring >= _core_rings[1][0] ? 1 : 0));
+    __sev();                // Wake the consumer if it is waiting
+
+    return (true);
+}
+
+static void _ring_count_drop(_msg_ring_t* ring, msg_id_t id) {
+    // Count the drop (this producer is the only writer of these)
+    uint producer = (uint)(ring - &_core_rings[0][0][0]) % RING_PRODUCERS_NUM;
+    ring->drops++;
+    int id_index = cmt_msg_id_index(id);
+    if (MSG_ID_INDEX_NONE != id_index) {
+        _id_drops[producer][id_index]++;
+    }
+}
+
+/*
+ * Add to a ring, waiting for room if `can_wait`. Returns false if the ring is full
+ * and it can't wait.
+ */
+static bool _ring_add_blocking(_msg_ring_t* ring, const _qmsg_t* qmsg, bool can_wait) {
+    while (!_ring_try_add(ring, qmsg)) {
+        if (!can_wait) {
+            return (false);
+        }
+        __wfe();            // The consumer signals when it frees a slot
+    }
+    return (true);
+}
+
+static bool _ring_try_remove(_msg_ring_t* ring, _qmsg_t* qmsg) {
+    uint32_t tail = ring->tail;
+    if (ring->head == tail) {
+        return (false); // Empty
+    }
+    __mem_fence_acquire();  // Read the slot after seeing the head that published it
+    *qmsg = ring->slots[tail & CORE_RING_MASK];
+    __mem_fence_release();  // Finish reading the slot before giving it back
+    ring->tail = tail + 1;
+    __sev();                // Wake a producer if it is waiting for room
+
+    return (true);
+}
+
+static void _lane_stats_update(uint8_t corenum, msg_lane_stats_t* stats, _msg_ring_t* lane_rings, const cmt_msg_t* msg) {
+    uint depth = 1; // The message being retrieved
+    for (int r = 0; r < RING_PRODUCERS_NUM; r++) {
+        depth += _ring_level(&lane_rings[r]);
+    }
+    uint32_t latency = time_us_32() - msg->t;
+    stats->retrieved++;
+    stats->latency_us_total += latency;
+    if (latency > stats->latency_us_max) {
+        stats->latency_us_max = latency;
+    }
+    if (depth > stats->depth_max) {
+        stats->depth_max = depth;
+    }
+    if (depth > _depth_peak[corenum]) {
+        _depth_peak[corenum] = depth;
+    }
+}
+
+static bool _get_core_msg_nowait(uint8_t corenum, cmt_msg_t* msg) {
+    if (SLAB_NONE != _held_block[corenum]) {
+        // The last message has been handled. Release its data.
+        _slab_release(_held_block[corenum]);
+        _held_block[corenum] = SLAB_NONE;
+    }
+    if (_lane_stats_reset[corenum]) {
+        memset(_lane_stats[corenum], 0, sizeof(_lane_stats[corenum]));
+        _lane_stats_reset[corenum] = false;
+    }
+    // Check the lanes in priority order. Within a lane, check each producer's ring,
+    // starting after the last one a message was taken from.
+    for (int lane = 0; lane < MSG_LANES_NUM; lane++) {
+        _msg_ring_t* lane_rings = _core_rings[corenum][lane];
+        if (MSG_LANE_NORMAL == lane) {
+            if (_mailbox_try_remove(corenum, msg)) {
+                _lane_stats_update(corenum, &_lane_stats[corenum][lane], lane_rings, msg);
+                return (true);
+            }
+        }
+        uint first = _next_ring[corenum][lane];
+        for (uint i = 0; i < RING_PRODUCERS_NUM; i++) {
+            uint r = (first + i) % RING_PRODUCERS_NUM;
+            _qmsg_t qmsg;
+            if (_ring_try_remove(&lane_rings[r], &qmsg)) {
+                _qmsg_decode(corenum, &qmsg, msg);
+                _next_ring[corenum][lane] = (uint8_t)((r + 1) % RING_PRODUCERS_NUM);
+                _lane_stats_update(corenum, &_lane_stats[corenum][lane], lane_rings, msg);
+                return (true);
+            }
+        }
+    }
+    return (false);
+}
+
+static void _get_core_msg_blocking(uint8_t corenum, cmt_msg_t* msg) {
+    while (!_get_core_msg_nowait(corenum, msg)) {
+        __wfe();
+    }
+}
+
+void get_core0_msg_blocking(cmt_msg_t* msg) {
+    _get_core_msg_blocking(0, msg);
+}
+
+bool get_core0_msg_nowait(cmt_msg_t* msg) {
+    return (_get_core_msg_nowait(0, msg));
+}
+
 void get_core1_msg_blocking(cmt_msg_t* msg) {
-    queue_remove_blocking(&core1_queue, msg);
+    _get_core_msg_blocking(1, msg);
 }
 
 bool get_core1_msg_nowait(cmt_msg_t* msg) {
-    register bool retrieved = false;
-    uint32_t flags = save_and_disable_interrupts();
-    retrieved = queue_try_remove(&core1_queue, msg);
-    restore_interrupts(flags);
+    return (_get_core_msg_nowait(1, msg));
+}
 
-    return (retrieved);
+uint32_t multicore_depth_peak_take(uint8_t corenum) {
+    uint32_t peak = _depth_peak[corenum];
+    _depth_peak[corenum] = 0;
+    return (peak);
+}
+
+void multicore_lane_stats(uint8_t corenum, msg_lane_t lane, msg_lane_stats_t* stats) {
+    if (corenum < 2 && lane < MSG_LANES_NUM) {
+        // The consumer core may be updating these. They are informational, so a small inconsistency is okay.
+        *stats = _lane_stats[corenum][lane];
+    }
+}
+
+uint32_t multicore_drops(uint8_t corenum, msg_lane_t lane) {
+    uint32_t drops = 0;
+    if (corenum < 2 && lane < MSG_LANES_NUM) {
+        for (int r = 0; r < RING_PRODUCERS_NUM; r++) {
+            drops += _core_rings[corenum][lane][r].drops;
+        }
+    }
+    return (drops);
+}
+
+uint32_t multicore_drops_for_id(msg_id_t id) {
+    uint32_t drops = 0;
+    int id_index = cmt_msg_id_index(id);
+    if (MSG_ID_INDEX_NONE != id_index) {
+        for (int p = 0; p < RING_PRODUCERS_NUM; p++) {
+            drops += _id_drops[p][id_index];
+        }
+    }
+    return (drops);
+}
+
+void multicore_drops_check(uint8_t corenum) {
+    if (corenum > 1) {
+        return;
+    }
+    uint32_t drops = 0;
+    for (int lane = 0; lane < MSG_LANES_NUM; lane++) {
+        drops += multicore_drops(corenum, (msg_lane_t)lane);
+    }
+    uint32_t now = now_ms();
+    if (drops != _drops_warned[corenum] && (now - _drops_warn_ts[corenum]) >= DROPS_WARN_INTERVAL_MS) {
+        warn_printf(true, "CMT - %u message posts to core %d dropped (queue full). Total: %u  See '.ps'.\n",
+            drops - _drops_warned[corenum], corenum, drops);
+        _drops_warned[corenum] = drops;
+        _drops_warn_ts[corenum] = now;
+    }
+}
+
+void multicore_msg_release_fn_set(msg_id_t id, msg_release_fn release_fn) {
+    int id_index = cmt_msg_id_index(id);
+    if (MSG_ID_INDEX_NONE != id_index) {
+        _release_fns[id_index] = release_fn;
+    }
+}
+
+void multicore_slab_status(int* blocks, int* high_water) {
+    *blocks = CMT_MSG_SLAB_BLOCKS;
+    *high_water = _slab_high_water;
+}
+
+uint32_t multicore_coalesced(uint8_t corenum) {
+    return (corenum < 2 ? _mailboxes_coalesced[corenum] : 0);
+}
+
+void multicore_lane_stats_reset(uint8_t corenum) {
+    if (corenum < 2) {
+        _lane_stats_reset[corenum] = true;
+    }
 }
 
 void multicore_module_init() {
     assert(!_initialized);
     _initialized = true;
-    queue_init(&core0_queue, sizeof(cmt_msg_t), CORE0_QUEUE_ENTRIES_MAX);
-    queue_init(&core1_queue, sizeof(cmt_msg_t), CORE1_QUEUE_ENTRIES_MAX);
+    memset(_core_rings, 0, sizeof(_core_rings));
+    memset(_lane_stats, 0, sizeof(_lane_stats));
+    _mailbox_lock = spin_lock_init(spin_lock_claim_unused(true));
+    _slab_lock = spin_lock_init(spin_lock_claim_unused(true));
+    for (int i = 0; i < CMT_MSG_SLAB_BLOCKS; i++) {
+        _slab[i].refs = 0;
+        _slab[i].next_free = (i + 1 < CMT_MSG_SLAB_BLOCKS ? i + 1 : SLAB_NONE);
+    }
+    _slab_free = 0;
+    _held_block[0] = SLAB_NONE;
+    _held_block[1] = SLAB_NONE;
     cmt_module_init();
 }
 
-static void _check_q0_level(char c, int id) {
+static void _check_ring_level(const _msg_ring_t* ring, uint8_t corenum) {
     if (debug_mode_enabled()) {
-        uint level = queue_get_level(&core0_queue);
-        if (CORE0_QUEUE_ENTRIES_MAX - level < 2) {
-            cmt_msg_t msg;
-            uint32_t now = now_ms();
-            if (queue_try_peek(&core0_queue, &msg)) {
-                printf("\n!!! Q0 level %u - Head Msg:%#04.4x TIQ:%dms !!!", level, msg.id, now - msg.t);
-            }
+        uint level = _ring_level(ring);
+        if (CORE_RING_ENTRIES - level < 2) {
+            // Peek at the oldest message (the consumer may take it while we look, but this is only informational).
+            const _qmsg_t* msg = &ring->slots[ring->tail & CORE_RING_MASK];
+            uint32_t now = time_us_32();
+            int ringnum = (int)(ring - &_core_rings[corenum][0][0]);
+            printf("\n!!! Q%d lane %d ring %d level %u - Head Msg:%#04.4x TIQ:%uus !!!", corenum, ringnum / RING_PRODUCERS_NUM, ringnum % RING_PRODUCERS_NUM, level, (msg->id & ~QMSG_SLAB_FLAG), now - msg->t);
         }
     }
 }
 
-static void _check_q1_level(char c, int id) {
-    if (debug_mode_enabled()) {
-        uint level = queue_get_level(&core1_queue);
-        if (CORE1_QUEUE_ENTRIES_MAX - level < 2) {
-            cmt_msg_t msg;
-            uint32_t now = now_ms();
-            if (queue_try_peek(&core1_queue, &msg)) {
-                printf("\n!!! Q1 level %u - Head Msg:%#04.4x TIQ:%dms !!!", level, msg.id, now - msg.t);
-            }
+/*
+ * Release the block held by this core's thread for the message it is handling,
+ * if that can be done before the handler finishes. It can if the message ID
+ * doesn't have a release function, as the handler has its own copy of the data.
+ * Returns true if a block was released.
+ */
+static bool _held_block_release_early() {
+    if (0 != __get_current_exception()) {
+        return (false);     // The block belongs to the thread (the IRQ interrupted its handler)
+    }
+    uint8_t corenum = (uint8_t)get_core_num();
+    uint8_t bn = _held_block[corenum];
+    if (SLAB_NONE == bn) {
+        return (false);
+    }
+    int id_index = cmt_msg_id_index((msg_id_t)_slab[bn].msg_id);
+    if (MSG_ID_INDEX_NONE != id_index && NULL != _release_fns[id_index]) {
+        return (false);     // Releasing it would free resources the handler is using
+    }
+    _held_block[corenum] = SLAB_NONE;
+    _slab_release(bn);
+
+    return (true);
+}
+
+/*
+ * Check if a blocking post to `cores` can wait for room. It can only wait from thread
+ * mode for the other core. The consumer on this core can't run while we wait (we are
+ * it, or we interrupted it).
+ */
+static bool _post_can_wait(uint8_t cores) {
+    return (0 == __get_current_exception() && 0 == (cores & (1u << get_core_num())));
+}
+
+/*
+ * Count a post that couldn't be queued as dropped for each of the cores, and release
+ * the resources in its data (as no core will handle it).
+ */
+static void _post_drop(uint8_t ring_cores, const cmt_msg_t* msg) {
+    for (uint8_t corenum = 0; corenum < 2; corenum++) {
+        if (ring_cores & (1u << corenum)) {
+            _ring_count_drop(_producer_ring(corenum, msg->id), msg->id);
         }
     }
+    int id_index = cmt_msg_id_index(msg->id);
+    msg_release_fn release_fn = (MSG_ID_INDEX_NONE != id_index ? _release_fns[id_index] : NULL);
+    if (release_fn) {
+        msg_data_value_t data = msg->data;
+        release_fn(&data);
+    }
 }
 
-static void _copy_and_set_timestamp(cmt_msg_t *msg, const cmt_msg_t *msgsrc) {
-    memcpy(msg, msgsrc, sizeof(cmt_msg_t));
-    msg->t = now_ms();
+/*
+ * Post a message to one or both cores (`cores` bit 0 is core 0, bit 1 is core 1).
+ * Returns the cores it was posted to (the same bits).
+ */
+static uint16_t _post_msg(uint8_t cores, const cmt_msg_t* msg, bool blocking) {
+    uint16_t posted = 0;
+    uint8_t ring_cores = 0;
+    uint8_t refs = 0;
+    int mbnum = _mailbox_for_id(msg->id);
+    for (uint8_t corenum = 0; corenum < 2; corenum++) {
+        uint8_t corebit = (1u << corenum);
+        if (cores & corebit) {
+            if (MAILBOX_NONE != mbnum) {
+                _mailbox_post(corenum, mbnum, msg);
+                posted |= corebit;
+            }
+            else {
+                ring_cores |= corebit;
+                refs++;
+            }
+        }
+    }
+    if (0 == ring_cores) {
+        return (posted);
+    }
+    // Blocking and IRQ posts can use the slab reserve.
+    bool reserve = (blocking || 0 != __get_current_exception());
+    _qmsg_t qmsg;
+    bool encoded = _qmsg_encode(msg, refs, reserve, &qmsg);
+    if (!encoded && blocking) {
+        // No slab block for the data. Free the one held for the message this thread is
+        // handling (if it can be). If the consumers are all on the other core, wait a while
+        // for one of them to free one (not forever, that core could be waiting on us).
+        encoded = (_held_block_release_early() && _qmsg_encode(msg, refs, reserve, &qmsg));
+        if (!encoded && _post_can_wait(ring_cores)) {
+            uint32_t start = time_us_32();
+            while (!(encoded = _qmsg_encode(msg, refs, reserve, &qmsg))
+                && (time_us_32() - start) < (CMT_MSG_SLAB_WAIT_MS * 1000)) {
+                tight_loop_contents();
+            }
+        }
+    }
+    if (!encoded) {
+        _post_drop(ring_cores, msg);
+        return (posted);
+    }
+    for (uint8_t corenum = 0; corenum < 2; corenum++) {
+        uint8_t corebit = (1u << corenum);
+        if (ring_cores & corebit) {
+            _msg_ring_t* ring = _producer_ring(corenum, msg->id);
+            _check_ring_level(ring, corenum);
+            bool added = (blocking ? _ring_add_blocking(ring, &qmsg, _post_can_wait(corebit)) : _ring_try_add(ring, &qmsg));
+            if (added) {
+                posted |= corebit;
+            }
+            else {
+                _ring_count_drop(ring, msg->id);
+                if (qmsg.id & QMSG_SLAB_FLAG) {
+                    _slab_release((uint8_t)qmsg.payload);  // This core won't be using it
+                }
+            }
+        }
+    }
+    return (posted);
 }
 
-void post_to_core0_blocking(const cmt_msg_t *msg) {
-    cmt_msg_t m; // queue_add copies the contents, so on the stack is okay.
-    _copy_and_set_timestamp(&m, msg);
-    _check_q0_level('B', m.id);
-    uint32_t flags = save_and_disable_interrupts();
-    queue_add_blocking(&core0_queue, &m);
-    restore_interrupts(flags);
+bool post_to_core0_blocking(const cmt_msg_t *msg) {
+    return (0 != _post_msg(0x01, msg, true));
 }
 
 bool post_to_core0_nowait(const cmt_msg_t *msg) {
-    cmt_msg_t m; // queue_add copies the contents, so on the stack is okay.
-    _copy_and_set_timestamp(&m, msg);
-    _check_q0_level('N', m.id);
-    register bool posted = false;
-    uint32_t flags = save_and_disable_interrupts();
-    posted = queue_try_add(&core0_queue, &m);
-    restore_interrupts(flags);
-
-    return (posted);
+    return (0 != _post_msg(0x01, msg, false));
 }
 
-void post_to_core1_blocking(const cmt_msg_t* msg) {
-    cmt_msg_t m; // queue_add copies the contents, so on the stack is okay.
-    _copy_and_set_timestamp(&m, msg);
-    _check_q1_level('B', m.id);
-    uint32_t flags = save_and_disable_interrupts();
-    queue_add_blocking(&core1_queue, &m);
-    restore_interrupts(flags);
+bool post_to_core1_blocking(const cmt_msg_t* msg) {
+    return (0 != _post_msg(0x02, msg, true));
 }
 
 bool post_to_core1_nowait(const cmt_msg_t* msg) {
-    cmt_msg_t m; // queue_add copies the contents, so on the stack is okay.
-    _copy_and_set_timestamp(&m, msg);
-    _check_q1_level('N', m.id);
-    register bool posted = false;
-    uint32_t flags = save_and_disable_interrupts();
-    posted = queue_try_add(&core1_queue, &m);
-    restore_interrupts(flags);
-
-    return (posted);
+    return (0 != _post_msg(0x02, msg, false));
 }
 
-void post_to_cores_blocking(const cmt_msg_t* msg) {
-    post_to_core0_blocking(msg);
-    post_to_core1_blocking(msg);
+bool post_to_cores_blocking(const cmt_msg_t* msg) {
+    return (0x03 == _post_msg(0x03, msg, true));
 }
 
 uint16_t post_to_cores_nowait(const cmt_msg_t* msg) {
-    uint16_t retval = 0;
-    if (post_to_core0_nowait(msg)) {
-        retval |= 0x01;
-    }
-    if (post_to_core1_nowait(msg)) {
-        retval |= 0x02;
-    }
-    return (retval);
+    return (_post_msg(0x03, msg, false));
 }
 
 void start_core1() {
@@ -14,7 +14,6 @@ extern "C" {
 #endif
 
 #include "pico/multicore.h"
-#include "pico/util/queue.h"
 #include "cmt.h"
 
 /**
@@ -32,13 +31,68 @@ extern "C" {
  * cause the Pico SDK/runtime to use them.
  *
  * For general purpose application communication between the functionality running on
- * the two cores queues will be used.
+ * the two cores lock-free single-producer/single-consumer rings are used. Each core has
+ * a ring for each posting context (thread mode and IRQ mode on each core), so posting
+ * and retrieving messages never disables interrupts. Messages from a single posting
+ * context are received in order.
+ *
+ * Messages are queued in a compact (8 byte) form. Data that doesn't fit in 16 bits
+ * is put in a reference counted slab block, which is shared when a message is posted
+ * to both cores and is freed after the last core has handled the message. The last
+ * few blocks are kept for blocking and IRQ posts.
+ *
+ * A blocking post only waits (for ring room or a slab block) from thread mode when
+ * posting to the other core. The consumer on its own core can't run while it waits
+ * (it is the consumer, or it interrupted it), so there it fails instead. The wait for
+ * a slab block is also limited, so two cores posting to each other can't deadlock. A
+ * blocking post that fails is counted as dropped and returns false.
+ *
+ * Messages are posted into one of two priority lanes based on their ID. User input
+ * goes in the high lane, which is always emptied before the normal (housekeeping)
+ * lane is read.
+ *
+ * Idempotent periodic messages (panel 21ms repeat, blink toggles, TOD update) are
+ * 'latest-value-wins'. If one hasn't been retrieved when the next is posted, it is
+ * overwritten rather than queued again (and counted as coalesced). The post always
+ * succeeds.
  *
  * @addtogroup mk_multicore
  * @include multicore.c
  *
 */
 
+/**
+ * @brief Message priority lanes.
+ * @ingroup mk_multicore
+ */
+typedef enum _MSG_LANE_ {
+    MSG_LANE_HIGH = 0,
+    MSG_LANE_NORMAL,
+    MSG_LANES_NUM
+} msg_lane_t;
+
+/**
+ * @brief Statistics for a priority lane of a core's messages.
+ * @ingroup mk_multicore
+ */
+typedef struct _MSG_LANE_STATS_ {
+    uint32_t retrieved;         // Messages retrieved from the lane
+    uint32_t depth_max;         // Most messages in the lane (when a message was retrieved)
+    uint32_t latency_us_max;    // Longest time from post to retrieve
+    uint64_t latency_us_total;  // Total of the post to retrieve times (for the average)
+} msg_lane_stats_t;
+
+/**
+ * @brief Function prototype for releasing resources in a message's data.
+ * @ingroup mk_multicore
+ *
+ * Called once, after every core that the message was posted to has handled it
+ * (or it was dropped).
+ *
+ * @param data The message data.
+ */
+typedef void (*msg_release_fn)(msg_data_value_t* data);
+
 /**
  * @brief Get a message for Core 0 (from the Core 0 queue). Block until a message can be read.
  *
@@ -71,6 +125,112 @@ void get_core1_msg_blocking(cmt_msg_t* msg);
  */
 bool get_core1_msg_nowait(cmt_msg_t* msg);
 
+/**
+ * @brief Get the priority lane that messages with an ID are posted in.
+ * @ingroup mk_multicore
+ *
+ * @param id The message ID.
+ * @return msg_lane_t The lane.
+ */
+msg_lane_t msg_lane_for_id(msg_id_t id);
+
+/**
+ * @brief Get the statistics for a priority lane of a core's messages.
+ * @ingroup mk_multicore
+ *
+ * The statistics are accumulated from startup or the last reset.
+ *
+ * @param corenum The core number (0|1).
+ * @param lane The lane.
+ * @param stats Pointer to the structure to fill in.
+ */
+void multicore_lane_stats(uint8_t corenum, msg_lane_t lane, msg_lane_stats_t* stats);
+
+/**
+ * @brief Set a function to release resources in the data of messages with an ID.
+ * @ingroup mk_multicore
+ *
+ * This allows a message that refers to an allocated resource (for example, a
+ * string) to be posted to both cores. The resource is released once, after
+ * both cores have handled the message.
+ *
+ * @param id The message ID.
+ * @param release_fn The release function (NULL to clear).
+ */
+void multicore_msg_release_fn_set(msg_id_t id, msg_release_fn release_fn);
+
+/**
+ * @brief Get the message data slab size and the most blocks that have been in use.
+ * @ingroup mk_multicore
+ *
+ * @param blocks Set to the number of slab blocks.
+ * @param high_water Set to the most blocks in use at one time.
+ */
+void multicore_slab_status(int* blocks, int* high_water);
+
+/**
+ * @brief Get the number of 'latest-value-wins' messages that were coalesced for a core.
+ * @ingroup mk_multicore
+ *
+ * This is the number of posts that overwrote a message that hadn't been retrieved yet.
+ *
+ * @param corenum The core number (0|1).
+ * @return uint32_t The number of coalesced posts since startup.
+ */
+uint32_t multicore_coalesced(uint8_t corenum);
+
+/**
+ * @brief Get the number of posts to a core's lane that were dropped (the ring or the slab was full).
+ * @ingroup mk_multicore
+ *
+ * @param corenum The core number (0|1).
+ * @param lane The lane.
+ * @return uint32_t The number of dropped posts since startup.
+ */
+uint32_t multicore_drops(uint8_t corenum, msg_lane_t lane);
+
+/**
+ * @brief Get the number of posts of a message ID that were dropped (to either core).
+ * @ingroup mk_multicore
+ *
+ * @param id The message ID.
+ * @return uint32_t The number of dropped posts since startup.
+ */
+uint32_t multicore_drops_for_id(msg_id_t id);
+
+/**
+ * @brief Warn (on the terminal) if posts to a core have been dropped.
+ * @ingroup mk_multicore
+ *
+ * This is called by the core's message loop (not from an ISR). The warning is
+ * rate limited, and only given if there have been new drops.
+ *
+ * @param corenum The core number (0|1) of the calling message loop.
+ */
+void multicore_drops_check(uint8_t corenum);
+
+/**
+ * @brief Get (and reset) the most messages that were in a lane of a core's queue
+ *      since the last call.
+ * @ingroup mk_multicore
+ *
+ * Only the core itself (its message loop) should call this.
+ *
+ * @param corenum The core number (0|1) of the calling message loop.
+ * @return uint32_t The peak lane depth.
+ */
+uint32_t multicore_depth_peak_take(uint8_t corenum);
+
+/**
+ * @brief Request that a core's lane statistics be reset.
+ * @ingroup mk_multicore
+ *
+ * The reset is done by the core (the next time it looks for a message).
+ *
+ * @param corenum The core number (0|1).
+ */
+void multicore_lane_stats_reset(uint8_t corenum);
+
 /**
  * @brief Initialize the multicore environment to be ready to run the core1 functionality.
  * @ingroup mk_multicore
@@ -89,9 +249,13 @@ void multicore_module_init();
  *
  * Generally used for necessary operational information/instructions.
  *
+ * It only waits from thread mode on the other core. Otherwise, or if a data slab
+ * block doesn't free up in time, it fails and the message is counted as dropped.
+ *
  * @param msg The message to post.
+ * @returns true if message was posted.
  */
-void post_to_core0_blocking(const cmt_msg_t* msg);
+bool post_to_core0_blocking(const cmt_msg_t* msg);
 
 /**
  * @brief Post a message to Core 0 (using the Core 0 queue). Do not wait if it can't be posted.
@@ -100,6 +264,8 @@ void post_to_core0_blocking(const cmt_msg_t* msg);
  * Generally used for informational status. Especially information that
  * is updated on an ongoing basis.
  *
+ * A message that can't be posted is counted as dropped (see `multicore_drops`).
+ *
  * @param msg The message to post.
  * @returns true if message was posted.
  */
@@ -111,9 +277,13 @@ bool post_to_core0_nowait(const cmt_msg_t* msg);
  *
  * Generally used for necessary operational information/instructions.
  *
+ * It only waits from thread mode on the other core. Otherwise, or if a data slab
+ * block doesn't free up in time, it fails and the message is counted as dropped.
+ *
  * @param msg The message to post.
+ * @returns true if message was posted.
  */
-void post_to_core1_blocking(const cmt_msg_t* msg);
+bool post_to_core1_blocking(const cmt_msg_t* msg);
 
 /**
  * @brief Post a message to Core 1 (using the Core 1 queue). Do not wait if it can't be posted.
@@ -122,6 +292,8 @@ void post_to_core1_blocking(const cmt_msg_t* msg);
  * Generally used for informational status. Especially information that
  * is updated on an ongoing basis.
  *
+ * A message that can't be posted is counted as dropped (see `multicore_drops`).
+ *
  * @param msg The message to post.
  * @returns true if message was posted.
  */
@@ -133,12 +305,16 @@ bool post_to_core1_nowait(const cmt_msg_t* msg);
  *
  * Generally used for necessary operational information/instructions.
  *
- * @note Since this is posting the same message to both cores, it should not be used for messages
- *       that contain allocated resources, as both core's message handlers would try to free them.
+ * @note Since this is posting the same message to both cores, a message that contains an allocated
+ *       resource must not be freed by the handlers. Set a release function for the message ID
+ *       (`multicore_msg_release_fn_set`) to free it once both cores have handled it.
+ *
+ * It can fail (and the message is counted as dropped) as `post_to_core0_blocking` can.
  *
  * @param msg The message to post.
+ * @returns true if message was posted to both cores.
  */
-void post_to_cores_blocking(const cmt_msg_t* msg);
+bool post_to_cores_blocking(const cmt_msg_t* msg);
 
 /**
  * @brief Post a message to both Core 0 and Core 1 (using the Core 0 and Core 1 queues). Do not
@@ -148,8 +324,9 @@ void post_to_cores_blocking(const cmt_msg_t* msg);
  * Generally used for informational status. Especially information that
  * is updated on an ongoing basis.
  *
- * @note Since this is posting the same message to both cores, it should not be used for messages
- *       that contain allocated resources, as both core's message handlers would try to free them.
+ * @note Since this is posting the same message to both cores, a message that contains an allocated
+ *       resource must not be freed by the handlers. Set a release function for the message ID
+ *       (`multicore_msg_release_fn_set`) to free it once both cores have handled it.
  *
  * @param msg The message to post.
  * @return 0 Could not post to either. 1 Posted to Core 0. 2 Posted to Core 1. 3 Posted to both cores.
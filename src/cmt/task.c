@@ -0,0 +1,145 @@
+/**
+ * scores CMT tasks.
+ *
+ * Stackless (protothread style) tasks run by the message loops, that can wait for
+ * time, a message, or a flag without chaining `cmt_sleep_ms` callbacks.
+ *
+ * Copyright 2023 AESilky
+ * SPDX-License-Identifier: MIT License
+ *
+*/
+#include "task.h"
+
+#include "hardware/timer.h"
+#include "pico/platform.h"
+
+/*
+ * The tasks for each core. Only the core's thread uses its list, so no lock is needed.
+ * New tasks are added to the end and only `cmt_tasks_run` removes them, so a task
+ * can start/cancel tasks while the list is being walked.
+ */
+static cmt_task_t* _tasks[2];
+
+static void _task_step(cmt_task_t* task) {
+    task->wait = CMT_TASK_WAIT_NONE;
+    if (CMT_TASK_DONE == task->task_fn(task)) {
+        task->running = false;
+    }
+}
+
+bool cmt_task_start(cmt_task_t* task, cmt_task_fn task_fn, void* user_data) {
+    uint8_t corenum = (uint8_t)get_core_num();
+    if (task->listed && task->corenum != corenum) {
+        panic("CMT - Task started on core %d is running on core %d.", corenum, task->corenum);
+    }
+    task->task_fn = task_fn;
+    task->user_data = user_data;
+    task->lc = 0;
+    task->corenum = corenum;
+    task->running = true;
+    if (!task->listed) {
+        task->next = NULL;
+        cmt_task_t** tp = &_tasks[corenum];
+        while (*tp) {
+            tp = &(*tp)->next;
+        }
+        *tp = task;
+        task->listed = true;
+    }
+    _task_step(task);
+
+    return (task->running);
+}
+
+void cmt_task_cancel(cmt_task_t* task) {
+    task->running = false;
+}
+
+bool cmt_task_running(const cmt_task_t* task) {
+    return (task->running);
+}
+
+void cmt_task_wait_ms(cmt_task_t* task, int32_t ms) {
+    task->wake_us = time_us_64() + ((uint64_t)(ms > 0 ? ms : 0) * 1000);
+    task->wait = CMT_TASK_WAIT_MS;
+}
+
+void cmt_task_wait_us(cmt_task_t* task, uint32_t us) {
+    task->wake_us = time_us_64() + us;
+    task->wait = CMT_TASK_WAIT_MS;
+}
+
+void cmt_task_wait_msg(cmt_task_t* task, msg_id_t msg_id) {
+    task->msg_id = msg_id;
+    task->wait = CMT_TASK_WAIT_MSG;
+}
+
+void cmt_task_wait_flag(cmt_task_t* task, volatile bool* flag) {
+    task->flag = flag;
+    task->wait = CMT_TASK_WAIT_FLAG;
+}
+
+bool cmt_tasks_active(uint8_t corenum) {
+    return (NULL != _tasks[corenum]);
+}
+
+uint64_t cmt_tasks_run(uint8_t corenum, uint64_t now_us) {
+    uint64_t wake_us = UINT64_MAX;
+    cmt_task_t* prev = NULL;
+    cmt_task_t* task = _tasks[corenum];
+    while (task) {
+        if (task->running) {
+            bool ready = false;
+            switch (task->wait) {
+                case CMT_TASK_WAIT_NONE:
+                    ready = true;
+                    break;
+                case CMT_TASK_WAIT_MS:
+                    ready = (now_us >= task->wake_us);
+                    break;
+                case CMT_TASK_WAIT_FLAG:
+                    ready = *task->flag;
+                    break;
+                default:
+                    break;
+            }
+            if (ready) {
+                _task_step(task);
+            }
+            if (task->running) {
+                if (CMT_TASK_WAIT_MS == task->wait && task->wake_us < wake_us) {
+                    wake_us = task->wake_us;
+                }
+                else if (CMT_TASK_WAIT_NONE == task->wait) {
+                    wake_us = now_us;   // Don't sleep, it's ready to go again
+                }
+            }
+        }
+        cmt_task_t* next = task->next;
+        if (!task->running) {
+            // Remove it from the list
+            if (prev) {
+                prev->next = next;
+            }
+            else {
+                _tasks[corenum] = next;
+            }
+            task->listed = false;
+        }
+        else {
+            prev = task;
+        }
+        task = next;
+    }
+
+    return (wake_us);
+}
+
+void cmt_tasks_msg(uint8_t corenum, const cmt_msg_t* msg) {
+    for (cmt_task_t* task = _tasks[corenum]; task; task = task->next) {
+        if (task->running && CMT_TASK_WAIT_MSG == task->wait && task->msg_id == msg->id) {
+            task->msg = *msg;
+            _task_step(task);
+        }
+    }
+}
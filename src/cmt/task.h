@@ -0,0 +1,232 @@
+/**
+ * scores CMT tasks.
+ *
+ * Stackless (protothread style) tasks run by the message loops, that can wait for
+ * time, a message, or a flag without chaining `cmt_sleep_ms` callbacks.
+ *
+ * Copyright 2023 AESilky
+ * SPDX-License-Identifier: MIT License
+ *
+*/
+#ifndef _CMT_TASK_H_
+#define _CMT_TASK_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "cmt.h"
+
+#include "hardware/sync.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @file task.h
+ * @defgroup cmt_task cmt_task
+ * Stackless tasks.
+ *
+ * A task is a function that is written as straight line code with 'await' points.
+ * At an await the function returns to the message loop, and the loop calls it again
+ * when what it is waiting for has happened. The function resumes right after the
+ * await (a `switch` on the line number, as in protothreads).
+ *
+ * Since the task function returns at each await, its local variables are not kept.
+ * Anything that must live across an await needs to be in static/module data or
+ * pointed to by the task `user_data`. Only one await can be on a source line.
+ *
+ * A task runs on the core that started it. The loop checks the task's wait on each
+ * pass, so there is no scheduled message or queue round-trip for each step.
+ *
+ * Example:
+ * @code
+ * static cmt_task_status_t _blink_task(cmt_task_t* task) {
+ *     CMT_TASK_BEGIN(task);
+ *     while (_blinking) {
+ *         led_on(true);
+ *         CMT_TASK_AWAIT_MS(task, 100);
+ *         led_on(false);
+ *         CMT_TASK_AWAIT_MS(task, 400);
+ *     }
+ *     CMT_TASK_END(task);
+ * }
+ * @endcode
+ *
+ * @addtogroup cmt_task
+ * @include task.c
+ *
+*/
+
+typedef enum _CMT_TASK_STATUS_ {
+    CMT_TASK_WAITING = 0,
+    CMT_TASK_DONE,
+} cmt_task_status_t;
+
+typedef enum _CMT_TASK_WAIT_ {
+    CMT_TASK_WAIT_NONE = 0,     // Ready (resume on the next loop pass)
+    CMT_TASK_WAIT_MS,           // Wait until a time (ms or us)
+    CMT_TASK_WAIT_MSG,          // Wait for a message ID
+    CMT_TASK_WAIT_FLAG,         // Wait for a flag to be true
+} cmt_task_wait_t;
+
+typedef struct _CMT_TASK_ cmt_task_t;
+
+/**
+ * @brief Task function prototype.
+ * @ingroup cmt_task
+ *
+ * Written using the CMT_TASK_ macros.
+ *
+ * @param task The task being run.
+ * @return cmt_task_status_t CMT_TASK_WAITING at an await, CMT_TASK_DONE at the end.
+ */
+typedef cmt_task_status_t (*cmt_task_fn)(cmt_task_t* task);
+
+struct _CMT_TASK_ {
+    cmt_task_fn task_fn;
+    void* user_data;
+    cmt_task_t* next;           // Next task in the core's list
+    uint64_t wake_us;           // `time_us_64()` to resume at (CMT_TASK_WAIT_MS)
+    volatile bool* flag;        // Flag to resume on (CMT_TASK_WAIT_FLAG)
+    cmt_msg_t msg;              // The message that resumed the task (CMT_TASK_WAIT_MSG)
+    msg_id_t msg_id;            // Message ID to resume on (CMT_TASK_WAIT_MSG)
+    uint16_t lc;                // Local continuation (line to resume at)
+    uint8_t wait;               // cmt_task_wait_t
+    uint8_t corenum;            // Core the task runs on
+    bool running;
+    bool listed;                // In the core's list (removed by the loop once not running)
+};
+
+/** Start of the task function body */
+#define CMT_TASK_BEGIN(task)    switch ((task)->lc) { case 0:
+
+/** End of the task function body */
+#define CMT_TASK_END(task)      } (task)->lc = 0; return (CMT_TASK_DONE)
+
+/** End the task from within the body */
+#define CMT_TASK_EXIT(task)     do { (task)->lc = 0; return (CMT_TASK_DONE); } while (0)
+
+/** Return to the loop, resuming at this point (used by the awaits) */
+#define CMT_TASK_YIELD(task)    do { (task)->lc = __LINE__; return (CMT_TASK_WAITING); case __LINE__:; } while (0)
+
+/** Wait for a time (milliseconds) */
+#define CMT_TASK_AWAIT_MS(task, ms) \
+    do { cmt_task_wait_ms((task), (ms)); CMT_TASK_YIELD(task); } while (0)
+
+/** Wait for a time (microseconds) */
+#define CMT_TASK_AWAIT_US(task, us) \
+    do { cmt_task_wait_us((task), (us)); CMT_TASK_YIELD(task); } while (0)
+
+/** Wait for a message (posted to the task's core). The message is in `task->msg` when resumed. */
+#define CMT_TASK_AWAIT_MSG(task, id) \
+    do { cmt_task_wait_msg((task), (id)); CMT_TASK_YIELD(task); } while (0)
+
+/** Wait for a flag to be true (doesn't wait if it already is). */
+#define CMT_TASK_AWAIT_FLAG(task, flagp) \
+    do { if (!*(flagp)) { cmt_task_wait_flag((task), (flagp)); CMT_TASK_YIELD(task); } } while (0)
+
+/**
+ * @brief Start (or restart) a task on the calling core.
+ * @ingroup cmt_task
+ *
+ * The task runs right away, up to its first await. It must be started from the
+ * thread (not an IRQ) of the core it is to run on. If the message loop isn't running
+ * yet, the task continues once it is. Restarting a running task starts it over.
+ *
+ * @param task The task (must stay allocated while the task is running).
+ * @param task_fn The task function.
+ * @param user_data Data for the task (available as `task->user_data`).
+ * @return true The task is waiting (it will be continued by the loop).
+ * @return false The task ran to its end.
+ */
+extern bool cmt_task_start(cmt_task_t* task, cmt_task_fn task_fn, void* user_data);
+
+/**
+ * @brief Stop a task. It won't be resumed.
+ * @ingroup cmt_task
+ *
+ * Must be called from the core the task runs on.
+ *
+ * @param task The task.
+ */
+extern void cmt_task_cancel(cmt_task_t* task);
+
+/**
+ * @brief Indicate if a task is running (started and not yet done).
+ * @ingroup cmt_task
+ *
+ * @param task The task.
+ * @return true If it is running.
+ */
+extern bool cmt_task_running(const cmt_task_t* task);
+
+/**
+ * @brief Set a flag that a task may be waiting on and wake the loops.
+ * @ingroup cmt_task
+ *
+ * A loop that is idle (WFE) wakes on an interrupt on its own core, so this is
+ * needed when the flag is set from the other core.
+ *
+ * @param flag The flag.
+ */
+static inline void cmt_task_flag_set(volatile bool* flag) {
+    *flag = true;
+    __sev();
+}
+
+/**
+ * @brief Set up a task to wait for a time. Use CMT_TASK_AWAIT_MS.
+ * @ingroup cmt_task
+ */
+extern void cmt_task_wait_ms(cmt_task_t* task, int32_t ms);
+
+/**
+ * @brief Set up a task to wait for a time. Use CMT_TASK_AWAIT_US.
+ * @ingroup cmt_task
+ */
+extern void cmt_task_wait_us(cmt_task_t* task, uint32_t us);
+
+/**
+ * @brief Set up a task to wait for a message. Use CMT_TASK_AWAIT_MSG.
+ * @ingroup cmt_task
+ */
+extern void cmt_task_wait_msg(cmt_task_t* task, msg_id_t msg_id);
+
+/**
+ * @brief Set up a task to wait for a flag. Use CMT_TASK_AWAIT_FLAG.
+ * @ingroup cmt_task
+ */
+extern void cmt_task_wait_flag(cmt_task_t* task, volatile bool* flag);
+
+/**
+ * @brief Indicate if the core has tasks. Used by the message loop.
+ * @ingroup cmt_task
+ *
+ * @param corenum The core number.
+ * @return true If there are tasks to check.
+ */
+extern bool cmt_tasks_active(uint8_t corenum);
+
+/**
+ * @brief Resume the tasks on a core that are ready (time or flag). Used by the message loop.
+ * @ingroup cmt_task
+ *
+ * @param corenum The core number.
+ * @param now_us The current `time_us_64()`.
+ * @return uint64_t The earliest time a task is waiting for (UINT64_MAX if none).
+ */
+extern uint64_t cmt_tasks_run(uint8_t corenum, uint64_t now_us);
+
+/**
+ * @brief Resume the tasks on a core that are waiting for a message. Used by the message loop.
+ * @ingroup cmt_task
+ *
+ * @param corenum The core number.
+ * @param msg The message that was dispatched.
+ */
+extern void cmt_tasks_msg(uint8_t corenum, const cmt_msg_t* msg);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _CMT_TASK_H_
@@ -0,0 +1,162 @@
+/**
+ * scores CMT message trace.
+ *
+ * In-RAM trace of message posts, retrieves, and handler enter/exit
+ * for each core, with export as Chrome Trace (Perfetto) JSON or a
+ * compact binary dump.
+ *
+ * Copyright 2023 AESilky
+ * SPDX-License-Identifier: MIT License
+ *
+*/
+#include "trace.h"
+
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "pico/platform.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define _TRACE_MASK (CMT_TRACE_ENTRIES - 1)
+
+typedef struct _TRACE_RING_ {
+    volatile uint32_t head;     // Free-running count of events written
+    cmt_trace_event_t events[CMT_TRACE_ENTRIES];
+} _trace_ring_t;
+
+static _trace_ring_t _trace_rings[CMT_TRACE_RINGS];
+static volatile bool _trace_enabled = true;
+
+static const char* _trace_ring_names[CMT_TRACE_RINGS] = {
+    "Core 0", "Core 0 IRQ", "Core 1", "Core 1 IRQ"
+};
+
+void cmt_trace_event(cmt_trace_type_t type, uint16_t msg_id, uint8_t arg) {
+    if (_trace_enabled) {
+        // Only this core, in this mode, writes this ring (IRQ's that post don't preempt each other).
+        _trace_ring_t* ring = &_trace_rings[(get_core_num() << 1) | (0 != __get_current_exception())];
+        uint32_t head = ring->head;
+        cmt_trace_event_t* event = &ring->events[head & _TRACE_MASK];
+        event->ts_us = time_us_64();
+        event->msg_id = msg_id;
+        event->type = (uint8_t)type;
+        event->arg = arg;
+        ring->head = head + 1;
+    }
+}
+
+bool cmt_trace_enable(bool on) {
+    bool was = _trace_enabled;
+    _trace_enabled = on;
+    return (was);
+}
+
+void cmt_trace_clear() {
+    bool was = cmt_trace_enable(false);
+    memset(_trace_rings, 0, sizeof(_trace_rings));
+    cmt_trace_enable(was);
+}
+
+int cmt_trace_snapshot(int n, cmt_trace_event_t* events, int max) {
+    if (n < 0 || n >= CMT_TRACE_RINGS) {
+        return (0);
+    }
+    _trace_ring_t* ring = &_trace_rings[n];
+    uint32_t head = ring->head;
+    uint32_t count = (head < CMT_TRACE_ENTRIES ? head : CMT_TRACE_ENTRIES);
+    if (count > (uint32_t)max) {
+        count = max;    // Keep the newest
+    }
+    uint32_t first = head - count;
+    for (uint32_t i = 0; i < count; i++) {
+        events[i] = ring->events[(first + i) & _TRACE_MASK];
+    }
+    return ((int)count);
+}
+
+static void _put_le(uint8_t* p, uint64_t v, int len) {
+    for (int i = 0; i < len; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+int cmt_trace_write_bin(cmt_trace_bin_writer_fn writer, void* user_data) {
+    uint8_t rec[CMT_TRACE_BIN_EVENT_SIZE];
+    int written = 0;
+    bool was = cmt_trace_enable(false);
+
+    memcpy(rec, CMT_TRACE_BIN_MAGIC, 4);
+    rec[4] = CMT_TRACE_BIN_VERSION;
+    rec[5] = CMT_TRACE_RINGS;
+    rec[6] = CMT_TRACE_BIN_EVENT_SIZE;
+    rec[7] = 0;
+    writer(rec, 8, user_data);
+    for (int n = 0; n < CMT_TRACE_RINGS; n++) {
+        _trace_ring_t* ring = &_trace_rings[n];
+        uint32_t head = ring->head;
+        uint32_t count = (head < CMT_TRACE_ENTRIES ? head : CMT_TRACE_ENTRIES);
+        _put_le(rec, count, 4);
+        writer(rec, 4, user_data);
+        for (uint32_t i = head - count; i != head; i++) {
+            const cmt_trace_event_t* event = &ring->events[i & _TRACE_MASK];
+            _put_le(&rec[0], event->ts_us, 8);
+            _put_le(&rec[8], event->msg_id, 2);
+            rec[10] = event->type;
+            rec[11] = event->arg;
+            writer(rec, CMT_TRACE_BIN_EVENT_SIZE, user_data);
+            written++;
+        }
+    }
+
+    cmt_trace_enable(was);
+    return (written);
+}
+
+int cmt_trace_write_json(cmt_trace_writer_fn writer, void* user_data) {
+    char buf[128];
+    int written = 0;
+    bool was = cmt_trace_enable(false);
+
+    writer("{\"traceEvents\":[\n", user_data);
+    // Name the 'threads' (rings)
+    for (int n = 0; n < CMT_TRACE_RINGS; n++) {
+        snprintf(buf, sizeof(buf), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            (n ? ",\n" : ""), n, _trace_ring_names[n]);
+        writer(buf, user_data);
+    }
+    for (int n = 0; n < CMT_TRACE_RINGS; n++) {
+        _trace_ring_t* ring = &_trace_rings[n];
+        uint32_t head = ring->head;
+        uint32_t count = (head < CMT_TRACE_ENTRIES ? head : CMT_TRACE_ENTRIES);
+        for (uint32_t i = head - count; i != head; i++) {
+            const cmt_trace_event_t* event = &ring->events[i & _TRACE_MASK];
+            const char* ph;
+            const char* what;
+            switch (event->type) {
+                case CMT_TRACE_POST:
+                    ph = "i"; what = "post";
+                    break;
+                case CMT_TRACE_RETRIEVE:
+                    ph = "i"; what = "retrieve";
+                    break;
+                case CMT_TRACE_HANDLER_ENTER:
+                    ph = "B"; what = "handler";
+                    break;
+                case CMT_TRACE_HANDLER_EXIT:
+                    ph = "E"; what = "handler";
+                    break;
+                default:
+                    continue;
+            }
+            snprintf(buf, sizeof(buf), ",\n{\"name\":\"0x%03X\",\"cat\":\"%s\",\"ph\":\"%s\",%s\"ts\":%llu,\"pid\":0,\"tid\":%d,\"args\":{\"arg\":%u}}",
+                event->msg_id, what, ph, (*ph == 'i' ? "\"s\":\"t\"," : ""), event->ts_us, n, event->arg);
+            writer(buf, user_data);
+            written++;
+        }
+    }
+    writer("\n]}\n", user_data);
+
+    cmt_trace_enable(was);
+    return (written);
+}
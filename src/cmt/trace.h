@@ -0,0 +1,174 @@
+/**
+ * scores CMT message trace.
+ *
+ * In-RAM trace of message posts, retrieves, and handler enter/exit
+ * for each core, with export as Chrome Trace (Perfetto) JSON or a
+ * compact binary dump.
+ *
+ * Copyright 2023 AESilky
+ * SPDX-License-Identifier: MIT License
+ *
+*/
+#ifndef _CMT_TRACE_H_
+#define _CMT_TRACE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @file trace.h
+ * @defgroup cmt_trace cmt_trace
+ * Message trace.
+ *
+ * Each core has a trace ring for thread mode and one for IRQ mode. Each ring has
+ * a single writer (the core, in that mode), so recording an event is lock-free
+ * and only takes a few stores. The rings are fixed size and overwrite the oldest
+ * events, so they hold what each core was doing for the last little while.
+ * They can be written out as Chrome Trace JSON (`cmt_trace_write_json`) or as a
+ * compact binary dump (`cmt_trace_write_bin`).
+ *
+ * @addtogroup cmt_trace
+ * @include trace.c
+ *
+*/
+
+/** Set to 0 to compile out the message trace */
+#ifndef CMT_TRACE
+#define CMT_TRACE 1
+#endif
+/** Number of events in each trace ring (must be a power of 2) */
+#ifndef CMT_TRACE_ENTRIES
+#define CMT_TRACE_ENTRIES 128
+#endif
+/** Number of trace rings (thread and IRQ for each core) */
+#define CMT_TRACE_RINGS 4
+
+typedef enum _CMT_TRACE_TYPE_ {
+    CMT_TRACE_NONE = 0,
+    CMT_TRACE_POST,         // Message posted (arg is the core it was posted to)
+    CMT_TRACE_RETRIEVE,     // Message retrieved by the message loop
+    CMT_TRACE_HANDLER_ENTER,
+    CMT_TRACE_HANDLER_EXIT,
+} cmt_trace_type_t;
+
+typedef struct _CMT_TRACE_EVENT_ {
+    uint64_t ts_us;         // time_us_64() when the event occurred
+    uint16_t msg_id;
+    uint8_t type;           // cmt_trace_type_t
+    uint8_t arg;
+} cmt_trace_event_t;
+
+/**
+ * @brief Function prototype for writing out trace text.
+ * @ingroup cmt_trace
+ *
+ * @param str The text to write.
+ * @param user_data The value passed to `cmt_trace_write_json`.
+ */
+typedef void (*cmt_trace_writer_fn)(const char* str, void* user_data);
+
+/**
+ * @brief Function prototype for writing out binary trace data.
+ * @ingroup cmt_trace
+ *
+ * @param data The bytes to write.
+ * @param len The number of bytes.
+ * @param user_data The value passed to `cmt_trace_write_bin`.
+ */
+typedef void (*cmt_trace_bin_writer_fn)(const uint8_t* data, int len, void* user_data);
+
+/** Binary trace dump header magic ('CMTT') */
+#define CMT_TRACE_BIN_MAGIC "CMTT"
+/** Binary trace dump format version */
+#define CMT_TRACE_BIN_VERSION 1
+/** Size of an event record in the binary trace dump */
+#define CMT_TRACE_BIN_EVENT_SIZE 12
+
+#if CMT_TRACE
+#define CMT_TRACE_EVENT(type, msg_id, arg)  cmt_trace_event((type), (msg_id), (arg))
+#else
+#define CMT_TRACE_EVENT(type, msg_id, arg)  ((void)0)
+#endif
+
+/**
+ * @brief Record a trace event in the ring for the calling core and mode.
+ * @ingroup cmt_trace
+ *
+ * Use the CMT_TRACE_EVENT macro, so it is compiled out if CMT_TRACE is 0.
+ *
+ * @param type The event type.
+ * @param msg_id The message ID.
+ * @param arg Event argument (depends on the type).
+ */
+extern void cmt_trace_event(cmt_trace_type_t type, uint16_t msg_id, uint8_t arg);
+
+/**
+ * @brief Enable/disable recording trace events.
+ * @ingroup cmt_trace
+ *
+ * Recording is disabled while the trace is being exported, so the rings don't change.
+ *
+ * @param on True to record events.
+ * @return bool The previous state.
+ */
+extern bool cmt_trace_enable(bool on);
+
+/**
+ * @brief Clear the trace rings.
+ * @ingroup cmt_trace
+ */
+extern void cmt_trace_clear();
+
+/**
+ * @brief Copy the events of a trace ring (oldest first).
+ * @ingroup cmt_trace
+ *
+ * Ring `n` is (core * 2) for thread mode and (core * 2 + 1) for IRQ mode.
+ *
+ * @param n The ring number (0 to CMT_TRACE_RINGS-1).
+ * @param events Buffer for the events.
+ * @param max The size of the buffer (number of events).
+ * @return int The number of events copied.
+ */
+extern int cmt_trace_snapshot(int n, cmt_trace_event_t* events, int max);
+
+/**
+ * @brief Write out the trace rings as Chrome Trace (Perfetto) JSON.
+ * @ingroup cmt_trace
+ *
+ * The JSON is written in small pieces through the writer function, so it can
+ * go to the terminal, a file, etc. Recording is paused while it is written.
+ *
+ * @param writer Function to write out the text.
+ * @param user_data Value passed to the writer.
+ * @return int The number of events written.
+ */
+extern int cmt_trace_write_json(cmt_trace_writer_fn writer, void* user_data);
+
+/**
+ * @brief Write out the trace rings as a compact binary dump.
+ * @ingroup cmt_trace
+ *
+ * This is much smaller than the JSON (12 bytes per event), so it is quicker to
+ * get off the board. It can be turned into Chrome Trace JSON on the host. The
+ * dump is little-endian:
+ * - Header: CMT_TRACE_BIN_MAGIC (4), version (1), number of rings (1),
+ *   event record size (1), 0 (1).
+ * - For each ring (in ring number order): number of events (4), then the
+ *   events (oldest first), each: `ts_us` (8), `msg_id` (2), `type` (1), `arg` (1).
+ *
+ * Recording is paused while it is written.
+ *
+ * @param writer Function to write out the bytes.
+ * @param user_data Value passed to the writer.
+ * @return int The number of events written.
+ */
+extern int cmt_trace_write_bin(cmt_trace_bin_writer_fn writer, void* user_data);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _CMT_TRACE_H_
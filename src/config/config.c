@@ -243,6 +243,14 @@ int config_module_init() {
     _system_cfg.boot_cfg_number = -1; // Invalid number as flag
     _system_cfg.wifi_ssid = NULL;
     _system_cfg.wifi_password = NULL;
+    _system_cfg.amb_light = false;
+    static const config_amb_point_t amb_curve_default[] = {
+        { 0, 2 }, { 600, 6 }, { 1800, 11 }, { 3200, PANEL_BRIGHTNESS_MAX }
+    };
+    _system_cfg.amb_curve_points = sizeof(amb_curve_default) / sizeof(amb_curve_default[0]);
+    for (int i = 0; i < _system_cfg.amb_curve_points; i++) {
+        _system_cfg.amb_curve[i] = amb_curve_default[i];
+    }
 
     // Create a config object to use as the current
     config_t* cfg = config_new(NULL);
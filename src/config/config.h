@@ -18,6 +18,19 @@
 
 #define CONFIG_NAME_MAX_LEN 15
 #define CONFIG_VERSION 1
+#define CONFIG_AMB_CURVE_MAX 6
+
+/**
+ * @brief Ambient light curve point.
+ * @ingroup config
+ *
+ * The panel brightness level to use at an ambient light reading (ADC value).
+ * The levels between the points are interpolated.
+ */
+typedef struct _config_amb_point_ {
+    uint16_t light;
+    uint8_t level;
+} config_amb_point_t;
 
 typedef struct _config_ {
     /** Configuration Version */
@@ -50,6 +63,12 @@ typedef struct _sys_config_ {
     char* wifi_ssid;
     /** Number of characters to loop back for a space to wrap text (adjust for display size) */
     uint16_t disp_wrap_back;
+    /** An ambient light sensor is fitted (automatic panel brightness) */
+    bool amb_light;
+    /** Number of points in the ambient light curve */
+    uint8_t amb_curve_points;
+    /** Ambient light to panel brightness curve (in increasing light order) */
+    config_amb_point_t amb_curve[CONFIG_AMB_CURVE_MAX];
 } config_sys_t;
 
 /**
@@ -269,6 +269,8 @@ uint16_t cfo_read_sys_cfg(config_sys_t * sys_cfg) {
         | _SYSCFG_IR1_RC
         | _SYSCFG_IR2_RC
         | _SYSCFG_PANEL_TYPE
+        | _SYSCFG_AMB_LIGHT
+        | _SYSCFG_AMB_CURVE
         ); // Will clear as set
     FRESULT fr;
     FIL fil;
@@ -305,6 +307,8 @@ uint16_t cfo_read_sys_cfg(config_sys_t * sys_cfg) {
     not_init &= !_SYSCFG_NOT_LOADED;
     // Close file
     fr = f_close(&fil);
+    // The ambient light items are optional (the defaults are kept if they aren't in the file)
+    not_init &= ~(_SYSCFG_AMB_LIGHT | _SYSCFG_AMB_CURVE);
     // See if we got values for all needed settigs
     bool is_set = !(binary_from_int(not_init));
     if ((not_init & _SYSCFG_VER_ID) || CONFIG_VERSION != sys_cfg->cfg_version) {
@@ -82,6 +82,16 @@ static int _scih_ssid_writer(const sys_cfg_item_handler_class_t* self, const con
 static const struct _SYS_CFG_ITEM_HANDLER_CLASS_ _scihc_ssid =
 { "wifi_ssid", "Wi-Fi SSID (name)", _SYSCFG_WS_ID, _scih_ssid_reader, _scih_ssid_writer };
 
+static int _scih_amb_light_reader(const sys_cfg_item_handler_class_t* self, config_sys_t* sys_cfg, const char* value);
+static int _scih_amb_light_writer(const sys_cfg_item_handler_class_t* self, const config_sys_t* sys_cfg, char* buf, bool full);
+static const struct _SYS_CFG_ITEM_HANDLER_CLASS_ _scihc_amb_light =
+{ "amb_light", "Ambient light sensor fitted", _SYSCFG_AMB_LIGHT, _scih_amb_light_reader, _scih_amb_light_writer };
+
+static int _scih_amb_curve_reader(const sys_cfg_item_handler_class_t* self, config_sys_t* sys_cfg, const char* value);
+static int _scih_amb_curve_writer(const sys_cfg_item_handler_class_t* self, const config_sys_t* sys_cfg, char* buf, bool full);
+static const struct _SYS_CFG_ITEM_HANDLER_CLASS_ _scihc_amb_curve =
+{ "amb_curve", "Ambient light to brightness curve", _SYSCFG_AMB_CURVE, _scih_amb_curve_reader, _scih_amb_curve_writer };
+
 static const sys_cfg_item_handler_class_t* _cfg_sys_handlers[] = {
     &_scihc_tz_offset,
     &_scihc_boot_cfg_number,
@@ -91,6 +101,8 @@ static const sys_cfg_item_handler_class_t* _cfg_sys_handlers[] = {
     &_scihc_ir1_rc,
     &_scihc_ir2_rc,
     &_scihc_panel_type,
+    &_scihc_amb_light,
+    &_scihc_amb_curve,
     ((const sys_cfg_item_handler_class_t*)0), // NULL last item to signify end
 };
 
@@ -261,6 +273,81 @@ static int _scih_ir2_rc_writer(const sys_cfg_item_handler_class_t* self, const c
     return (len);
 }
 
+static int _scih_amb_light_reader(const sys_cfg_item_handler_class_t* self, config_sys_t* sys_cfg, const char* value) {
+    int retval = -1;
+
+    bool b = bool_from_str(value);
+    sys_cfg->amb_light = b;
+    retval = 1;
+
+    return (retval);
+}
+
+static int _scih_amb_light_writer(const sys_cfg_item_handler_class_t* self, const config_sys_t* sys_cfg, char* buf, bool full) {
+    int len = 0;
+
+    // If full - print comment and key
+    if (full) {
+        len = sprintf(buf, "# Ambient light sensor is fitted (automatic panel brightness).\n%s=", self->key);
+    }
+    // format the value we are responsible for
+    len += sprintf(buf + len, "%hd", binary_from_int(sys_cfg->amb_light));
+
+    return (len);
+}
+
+static int _scih_amb_curve_reader(const sys_cfg_item_handler_class_t* self, config_sys_t* sys_cfg, const char* value) {
+    int retval = -1;
+    config_amb_point_t points[CONFIG_AMB_CURVE_MAX];
+    int n = 0;
+
+    // Points are 'light:level' separated by commas, in increasing light order.
+    const char* p = value;
+    while (p && *p && n < CONFIG_AMB_CURVE_MAX) {
+        char* end;
+        long light = strtol(p, &end, 10);
+        if (*end != ':') {
+            break;
+        }
+        long level = strtol(end + 1, &end, 10);
+        if (light < 0 || light > 4095 || level < 0 || level > PANEL_BRIGHTNESS_MAX
+            || (n > 0 && light <= points[n - 1].light)) {
+            break;
+        }
+        points[n].light = (uint16_t)light;
+        points[n].level = (uint8_t)level;
+        n++;
+        p = (*end == ',' ? end + 1 : (*end == '\000' ? NULL : end));
+    }
+    if (n > 0 && (NULL == p || '\000' == *p)) {
+        for (int i = 0; i < n; i++) {
+            sys_cfg->amb_curve[i] = points[i];
+        }
+        sys_cfg->amb_curve_points = (uint8_t)n;
+        retval = 1;
+    }
+    else {
+        error_printf(false, "Config - Invalid value for amb_curve: %s\n", value);
+    }
+
+    return (retval);
+}
+
+static int _scih_amb_curve_writer(const sys_cfg_item_handler_class_t* self, const config_sys_t* sys_cfg, char* buf, bool full) {
+    int len = 0;
+
+    // If full - print comment and key
+    if (full) {
+        len = sprintf(buf, "# Ambient light (0-4095) to panel brightness (0-15) curve 'light:level,...'.\n%s=", self->key);
+    }
+    // format the value we are responsible for
+    for (int i = 0; i < sys_cfg->amb_curve_points; i++) {
+        len += sprintf(buf + len, "%s%hu:%hu", (i ? "," : ""), sys_cfg->amb_curve[i].light, (uint16_t)sys_cfg->amb_curve[i].level);
+    }
+
+    return (len);
+}
+
 static int _scih_panel_type_reader(const sys_cfg_item_handler_class_t* self, config_sys_t* sys_cfg, const char* value) {
     int retval = -1;
 
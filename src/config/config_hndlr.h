@@ -26,6 +26,8 @@ extern "C" {
 #define _SYSCFG_IR1_RC      0x0040
 #define _SYSCFG_IR2_RC      0x0080
 #define _SYSCFG_PANEL_TYPE  0x0100
+#define _SYSCFG_AMB_LIGHT   0x0200  // Optional
+#define _SYSCFG_AMB_CURVE   0x0400  // Optional
 #define _SYSCFG_NOT_LOADED  0x8000
 
 
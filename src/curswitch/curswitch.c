@@ -14,6 +14,7 @@
 #include "curswitch.h"
 #include "board.h"
 #include "cmt/cmt.h"
+#include "cmt/task.h"
 
 #include "hardware/adc.h"
 
@@ -71,7 +72,7 @@ const sw_val_minmax_t _Sw_MinMax_Vals[] = {
     {SW_EN_VAL, SW_EN_VAL+ALLOWABLE_DELTA},
     };
 
-#define SW_READ_DELAY_MS         2 // Delay between reads to get consistant switch values
+#define SW_READ_DELAY_US      2000 // Delay between reads to get consistant switch values
 #define SW_READ_FAILSAFE_COUNT  40 // Number of times to try reads before giving up
 #define SW_READ_REPEAT_COUNT     8 // Number of times required reading the same switch number
 
@@ -81,6 +82,7 @@ static int _sw_bank_read_failsafe[SW_BANK_COUNT];
 
 static bool _sw_bank_enabled[SW_BANK_COUNT];
 static volatile bool _sw_bank_readinprogress[SW_BANK_COUNT];
+static cmt_task_t _sw_bank_read_task[SW_BANK_COUNT];
 
 /** State for the switches on the Bank. */
 static sw_state_t sw_bank_state[SW_BANK_COUNT][SW_COUNT];
@@ -164,51 +166,52 @@ static int _whats_pressed(uint sw_val) {
 }
 
 /**
- * Called from `cmt_sleep_ms` to read the bank again. This is done
- * until we get SW_READ_REPEAT_COUNT consistant switch number readings.
- * Note that the readings are the 'switch number' not the specific
- * ADC value.
+ * @brief Check if all of the switch number readings for a bank are the same.
  *
- * @param user_data Defined as a pointer, but directly contains the bank number.
+ * @param bank_index The bank index.
+ * @return true If the last SW_READ_REPEAT_COUNT readings are the same.
  */
-void _read_bank_delayed(void* user_data) {
-    switch_bank_t bank = (switch_bank_t)user_data;
-    int bank_index = bank + SW_BANK_INDEX_OFFSET;
-    int sw; // Use an 'int' so we can use non-switch values as flags
-    uint sw_val;
-    // Check all of the switch number readings to see if they are the same
-    bool all_the_same = true; // Hope for the best
+static bool _bank_readings_consistent(int bank_index) {
     for (int i=0; i<(SW_READ_REPEAT_COUNT-1); i++) {
         if (_sw_bank_readings[bank_index][i] != _sw_bank_readings[bank_index][i+1]) {
-            all_the_same = false;
-            break; // No need to check any more
+            return (false);
         }
     }
-    if (!all_the_same) {
-        // We need to read again...
-        if (--_sw_bank_read_failsafe[bank_index] <= 0) {
-            // We couldn't get consistant read values. Print a warning and give up.
-            warn_printf(true, "Read switch Bank%d failed to get consistant values.\n", bank);
-            _sw_bank_readinprogress[bank_index] = false;
-            return;
-        }
-        uint bank_adc = (bank == SWBANK1 ? SW_BANK1_ADC : SW_BANK2_ADC);
-        adc_select_input(bank_adc);
-        sw_val = adc_read();
-        sw = _whats_pressed(sw_val);
-        if (sw >= 0) {
-            _sw_bank_readings[bank_index][_sw_bank_read_index[bank_index]] = sw;
-            _sw_bank_read_index[bank_index]++;
-            if (_sw_bank_read_index[bank_index] >= SW_READ_REPEAT_COUNT) {
-                _sw_bank_read_index[bank_index] = 0;
-            }
+    return (true);
+}
+
+/**
+ * @brief Read the switch number for a bank and add it to the readings.
+ *
+ * Note that the readings are the 'switch number' not the specific ADC value.
+ *
+ * @param bank The bank.
+ * @param bank_index The bank index.
+ */
+static void _bank_reading_take(switch_bank_t bank, int bank_index) {
+    uint bank_adc = (bank == SWBANK1 ? SW_BANK1_ADC : SW_BANK2_ADC);
+    adc_select_input(bank_adc);
+    uint sw_val = adc_read();
+    int sw = _whats_pressed(sw_val); // Use an 'int' so we can use non-switch values as flags
+    if (sw >= 0) {
+        _sw_bank_readings[bank_index][_sw_bank_read_index[bank_index]] = sw;
+        _sw_bank_read_index[bank_index]++;
+        if (_sw_bank_read_index[bank_index] >= SW_READ_REPEAT_COUNT) {
+            _sw_bank_read_index[bank_index] = 0;
         }
-        cmt_sleep_ms(SW_READ_DELAY_MS, _read_bank_delayed, (void*)bank);
-        return;
     }
-    //
-    // We got consistant switch numbers from the required number of reads. Process the switch states.
-    sw = _sw_bank_readings[bank_index][0];
+}
+
+/**
+ * @brief Process consistant switch number readings for a bank.
+ *
+ * Updates the switch states and posts messages for the actions (releases first).
+ *
+ * @param bank The bank.
+ * @param bank_index The bank index.
+ */
+static void _bank_readings_process(switch_bank_t bank, int bank_index) {
+    int sw = _sw_bank_readings[bank_index][0];
     bool changes[SW_COUNT];
     switch_action_data_t presses[SW_COUNT];
     switch_action_data_t releases[SW_COUNT];
@@ -255,7 +258,33 @@ void _read_bank_delayed(void* user_data) {
             }
         }
     }
+}
+
+/**
+ * Task that reads a bank until we get SW_READ_REPEAT_COUNT consistant switch
+ * number readings (SW_READ_DELAY_US apart), and then processes the switch states.
+ *
+ * @param task The bank's task. The `user_data` directly contains the bank number.
+ */
+static cmt_task_status_t _read_bank_task(cmt_task_t* task) {
+    switch_bank_t bank = (switch_bank_t)task->user_data;
+    int bank_index = bank + SW_BANK_INDEX_OFFSET;
+    CMT_TASK_BEGIN(task);
+    while (!_bank_readings_consistent(bank_index)) {
+        // We need to read again...
+        if (--_sw_bank_read_failsafe[bank_index] <= 0) {
+            // We couldn't get consistant read values. Print a warning and give up.
+            warn_printf(true, "Read switch Bank%d failed to get consistant values.\n", bank);
+            _sw_bank_readinprogress[bank_index] = false;
+            CMT_TASK_EXIT(task);
+        }
+        _bank_reading_take(bank, bank_index);
+        CMT_TASK_AWAIT_US(task, SW_READ_DELAY_US);
+    }
+    // We got consistant switch numbers from the required number of reads. Process the switch states.
+    _bank_readings_process(bank, bank_index);
     _sw_bank_readinprogress[bank_index] = false;
+    CMT_TASK_END(task);
 }
 
 static void _read_bank(switch_bank_t bank) {
@@ -270,7 +299,7 @@ static void _read_bank(switch_bank_t bank) {
         int flag_val = -2 - i;
         _sw_bank_readings[bank_index][i] = flag_val;
     }
-    _read_bank_delayed((void*)bank);
+    cmt_task_start(&_sw_bank_read_task[bank_index], _read_bank_task, (void*)bank);
 }
 
 // ///////////////////////////////////////////////////////
@@ -0,0 +1,160 @@
+/**
+ * Scoreboard Panel ambient light (automatic brightness).
+ *
+ * The ADC is shared with the switch bank reads (`curswitch`) and the core
+ * temperature. Those use single `adc_read()` conversions from the core-0
+ * thread. The ambient light burst is done from the same thread, and the ADC
+ * is put back in single conversion mode (FIFO off) before returning, so they
+ * never see it in a different state.
+ *
+ * The sensor input (`AMB_LIGHT_GPIO`) defaults to GPIO29, which on a standard
+ * Pico is the VSYS/3 divider. The board has to be changed to use it (see
+ * system_defs.h), or the brightness follows the supply voltage.
+ *
+ * Copyright 2023-24 AESilky
+ * SPDX-License-Identifier: MIT License
+ *
+*/
+#include "ambient.h"
+#include "panel.h"
+
+#include "board.h"
+#include "system_defs.h"
+#include "config/config.h"
+
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+
+#if (AMB_LIGHT_GPIO < 26 || AMB_LIGHT_GPIO > 29 || AMB_LIGHT_ADC != (AMB_LIGHT_GPIO - 26))
+#error "AMB_LIGHT_GPIO must be an ADC input (GPIO26-29) and AMB_LIGHT_ADC its ADC input number."
+#endif
+
+#define _AMB_FILTER_SHIFT 3     // IIR filter - new = old + (sample - old) / 8
+#define _AMB_FRAC_BITS 4        // Fraction bits kept in the filter value
+
+static bool _amb_enabled;
+static int _amb_dma_channel;
+static uint16_t _amb_samples[AMB_BURST_SAMPLES];
+static int _amb_repeat_count;
+static bool _amb_filter_primed;
+static uint32_t _amb_filtered;      // Filtered light (with _AMB_FRAC_BITS fraction)
+static uint16_t _amb_light_at_set;  // The (filtered) light when the brightness was last set
+static int _amb_level;              // The brightness level last set (-1 if not set yet)
+
+/**
+ * @brief Read a burst of samples from the ambient light ADC input.
+ *
+ * The burst takes ~32us (16 conversions at 500k samples per second), with the
+ * DMA moving the samples from the ADC FIFO.
+ *
+ * @return uint16_t The average of the samples.
+ */
+static uint16_t _light_read() {
+    adc_select_input(AMB_LIGHT_ADC);
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_set_clkdiv(0);
+    adc_fifo_drain();
+    dma_channel_set_write_addr(_amb_dma_channel, _amb_samples, false);
+    dma_channel_set_trans_count(_amb_dma_channel, AMB_BURST_SAMPLES, true);
+    adc_run(true);
+    dma_channel_wait_for_finish_blocking(_amb_dma_channel);
+    // Put the ADC back into single conversion mode
+    adc_run(false);
+    adc_fifo_drain();
+    adc_fifo_setup(false, false, 0, false, false);
+
+    uint32_t sum = 0;
+    for (int i = 0; i < AMB_BURST_SAMPLES; i++) {
+        sum += _amb_samples[i];
+    }
+    return ((uint16_t)(sum / AMB_BURST_SAMPLES));
+}
+
+/**
+ * @brief Get the brightness level for a light value from the configured curve.
+ */
+static int _level_for_light(uint16_t light) {
+    const config_sys_t* cfgsys = config_sys();
+    const config_amb_point_t* curve = cfgsys->amb_curve;
+    int n = cfgsys->amb_curve_points;
+    if (n == 0) {
+        return (PANEL_BRIGHTNESS_MAX);
+    }
+    if (light <= curve[0].light) {
+        return (curve[0].level);
+    }
+    for (int i = 1; i < n; i++) {
+        if (light <= curve[i].light) {
+            // Interpolate between the points (rounded)
+            int dl = curve[i].light - curve[i - 1].light;
+            int dv = curve[i].level - curve[i - 1].level;
+            return (curve[i - 1].level + ((dv * (light - curve[i - 1].light)) + (dl / 2)) / dl);
+        }
+    }
+    return (curve[n - 1].level);
+}
+
+bool ambient_enabled() {
+    return (_amb_enabled);
+}
+
+uint16_t ambient_light() {
+    return ((uint16_t)(_amb_filtered >> _AMB_FRAC_BITS));
+}
+
+void ambient_update() {
+    if (!_amb_enabled || --_amb_repeat_count > 0) {
+        return;
+    }
+    _amb_repeat_count = AMB_READ_REPEATS;
+
+    uint32_t sample = (uint32_t)_light_read() << _AMB_FRAC_BITS;
+    if (!_amb_filter_primed) {
+        _amb_filtered = sample;
+        _amb_filter_primed = true;
+    }
+    else {
+        _amb_filtered = _amb_filtered + ((int32_t)(sample - _amb_filtered) >> _AMB_FILTER_SHIFT);
+    }
+    uint16_t light = ambient_light();
+    int level = _level_for_light(light);
+    if (level == _amb_level) {
+        return;
+    }
+    // Only change once the light has moved far enough, so it doesn't flip between levels.
+    int moved = (light > _amb_light_at_set ? light - _amb_light_at_set : _amb_light_at_set - light);
+    if (_amb_level < 0 || moved >= AMB_HYSTERESIS) {
+        _amb_level = level;
+        _amb_light_at_set = light;
+        panel_brightness_all_set((uint8_t)level);
+    }
+}
+
+void ambient_module_init() {
+    _amb_enabled = false;
+    _amb_repeat_count = AMB_READ_REPEATS;
+    _amb_filter_primed = false;
+    _amb_filtered = 0;
+    _amb_light_at_set = 0;
+    _amb_level = -1;
+    if (!config_sys()->amb_light) {
+        return;
+    }
+#if defined(BOARD_IS_PICOW) && (AMB_LIGHT_GPIO == 29)
+    warn_printf(false, "Ambient light sensor is configured, but the Pico-W uses GPIO%d for the radio.\n", AMB_LIGHT_GPIO);
+#else
+    adc_gpio_init(AMB_LIGHT_GPIO);
+    _amb_dma_channel = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(_amb_dma_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);   // Always read the ADC FIFO
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, DREQ_ADC);          // Paced by the ADC
+    dma_channel_configure(_amb_dma_channel, &c,
+        _amb_samples,                               // Destination
+        &adc_hw->fifo,                              // Source
+        AMB_BURST_SAMPLES,                          // Number of samples
+        false);                                     // Don't start yet
+    _amb_enabled = true;
+#endif
+}
@@ -0,0 +1,81 @@
+/**
+ * Scoreboard Panel ambient light (automatic brightness).
+ *
+ * Copyright 2023-24 AESilky
+ * SPDX-License-Identifier: MIT License
+ *
+*/
+#ifndef _SCORE_PANEL_AMBIENT_H_
+#define _SCORE_PANEL_AMBIENT_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @file ambient.h
+ * @defgroup panel_ambient panel_ambient
+ * Automatic panel brightness from an ambient light sensor.
+ *
+ * The sensor is on `AMB_LIGHT_GPIO` (GPIO29/ADC3 by default, which needs the
+ * Pico's VSYS divider removed - see system_defs.h) and is used if the system
+ * config has `amb_light` set. On GPIO29 the board has to be a Pico, as the
+ * Pico-W uses it for the radio. The light is read in a short DMA burst,
+ * filtered, and mapped to the panel brightness through the system config
+ * `amb_curve`.
+ *
+ * @addtogroup panel_ambient
+ * @include ambient.c
+ *
+*/
+
+/** Number of 21ms repeats between ambient light reads (~0.2 seconds) */
+#ifndef AMB_READ_REPEATS
+#define AMB_READ_REPEATS 10
+#endif
+/** Number of ADC samples in a read burst (averaged) */
+#define AMB_BURST_SAMPLES 16
+/** Change in (filtered) light needed before the brightness is changed (ADC counts) */
+#ifndef AMB_HYSTERESIS
+#define AMB_HYSTERESIS 48
+#endif
+
+/**
+ * @brief Indicate if the automatic brightness is running.
+ * @ingroup panel_ambient
+ *
+ * @return true If the ambient light sensor is configured and being read.
+ */
+extern bool ambient_enabled();
+
+/**
+ * @brief The filtered ambient light value.
+ * @ingroup panel_ambient
+ *
+ * @return uint16_t The light (ADC value 0-4095)
+ */
+extern uint16_t ambient_light();
+
+/**
+ * @brief Read the light and update the panel brightness when it is time to.
+ * @ingroup panel_ambient
+ *
+ * Called on each 21ms panel repeat by the core that reads the switch banks, so
+ * the ADC is only used by one thread.
+ */
+extern void ambient_update();
+
+/**
+ * @brief Initialize the ambient light sensor (if it is configured).
+ * @ingroup panel_ambient
+ *
+ * Must be called after the config and panel are initialized.
+ */
+extern void ambient_module_init();
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _SCORE_PANEL_AMBIENT_H_
@@ -45,8 +45,37 @@
  *
  * 1. Master            Allow enable (for all digits).
  * 2. Digit             Control for each digit individually
- * 2. Slow Flash        Driven by the DMA scan-end interrupt that flips at a slow rate
- * 3. Fast Flash        Driven by the DMA scan-end interrupt that flips at a fast rate
+ * 2. Slow Flash        Driven by the panel tick (21ms timer) that flips at a slow rate
+ * 3. Fast Flash        Driven by the panel tick (21ms timer) that flips at a fast rate
+ *
+ * The multiplexing is done by a PIO program. For each digit it pulls a word
+ * (segments and digit enable), drives it for ~97us, then turns everything off
+ * for a ~5us dead time (anti-ghosting) before pulling the next word. As it turns
+ * the outputs off before it waits for a word, a digit can't be left on if the
+ * words stop coming. The PIO can't keep the words itself (it can't put them back
+ * into its FIFO, and 'set' only has 5 bits), so a single DMA channel feeds it,
+ * paced by the PIO's TX FIFO, reading the scan sequence as a ring. The channel
+ * has a long transfer count that the panel tick re-arms.
+ *
+ * The flashing (blinking) is done with precomputed frames (digit control buffers).
+ * There is a frame for each combination of the fast and slow blink phases, with the
+ * blinking digits blanked in the 'off' phases. When a blink phase flips, the panel
+ * tick stops the DMA channel and restarts it at the next unsent word's offset in
+ * the other frame, so the CPU doesn't touch the segment data. The frames are only
+ * rebuilt when the segments, the brightness, or the blinking digits change.
+ *
+ * There are two sets of frames, front (being scanned) and back. The `panel_..._set`
+ * methods only change the segment values. On the 21ms repeat message the core that
+ * sets the panel builds the back set and marks it ready. The panel tick swaps the
+ * sets by restarting the channel in the other set, so it doesn't do any segment
+ * work, and a set is never written while the DMA may be reading it.
+ *
+ * The brightness of each digit (0-15) is done with binary-code-modulation. Each
+ * blink frame is a 16 scan sequence of bit-planes, where a digit is only on in the
+ * planes for the bits set in its level. The sequence has plane 3 in 8 scans, plane 2
+ * in 4, plane 1 in 2, plane 0 in 1, and a blank scan, spread out to keep the flicker
+ * down. A digit is still only enabled for one slot in a scan, so full brightness is
+ * 15/16 of the ~12% duty, and lower levels only reduce it.
  *
  * This module takes care of the physical display panel. The logic/decision
  * of what to put on the display is not in this module.
@@ -64,15 +93,22 @@
 
 #include "panel/segments7/segments7.h"
 
+#include "hardware/clocks.h"
 #include "hardware/dma.h" //The hardware DMA library
 #include "hardware/pio.h"
-#include "hardware/irq.h"
 #include "hardware/pwm.h"
 
 /////////////////////////////////////////////////////////////////////
 // Message Handling
 /////////////////////////////////////////////////////////////////////
 //
+static void _frames_publish();
+
+static void _panel_repeat_handler(cmt_msg_t* msg) {
+    _frames_publish();
+}
+const msg_handler_entry_t _panel_repeat_handler_entry = { MSG_PANEL_REPEAT_21MS, _panel_repeat_handler };
+
 void _panel_slowblnk_handler(cmt_msg_t* msg) {
     bool on = msg->data.bv;
     led_on(on);
@@ -113,11 +149,10 @@ static volatile panel_digit_enable_t _fast_blink_digit_ctrl; // Bit for each dig
 static bool _slow_blink_enable;
 static volatile panel_digit_enable_t _slow_blink_digit_ctrl; // Bit for each digit
 
-#define BLINK_FAST_LOAD 238 // 1/5 second (238 * 0.840ms)
-#define BLINK_SLOW_LOAD 595 // 1/2 second (595 * 0.840ms)
-#define REPETITIVE_LOAD  25 // For 21ms repetitive message
+#define PANEL_TICK_MS    21 // The panel tick (21ms repetitive message)
+#define BLINK_FAST_LOAD  10 // ~1/5 second (10 * 21ms)
+#define BLINK_SLOW_LOAD  24 // ~1/2 second (24 * 21ms)
 
-static int _repetitive_count;
 static int _fast_blink_count;
 static int _slow_blink_count;
 
@@ -140,70 +175,179 @@ static int _slow_blink_count;
  * 6 = IND
  */
 volatile digsegs_t _digits_segments[DIGITS_COUNT];
-volatile bool _segments_changed;
+volatile uint8_t _digits_level[DIGITS_COUNT];   // Brightness level for each digit (0-PANEL_BRIGHTNESS_MAX)
+volatile bool _segments_changed;   // Segments or blinking digits changed (the back frames need to be rebuilt)
 
 #define DIGITS_CTRL_BUF_SIZE DIGITS_COUNT //The size of the value+enable bytes for the 6 digits, indicators, and a blank
 
-volatile uint16_t _digits_ctrl_buf[DIGITS_CTRL_BUF_SIZE] __attribute__ ((aligned(16)));
+/**
+ * @brief Frame (digit control buffer) selection bits.
+ * @ingroup panel
+ */
+#define FRAME_FAST_OFF 0x01 // Fast blinking digits are blanked
+#define FRAME_SLOW_OFF 0x02 // Slow blinking digits are blanked
+#define FRAMES_COUNT 4      // Normal, fast-off, slow-off, both-off
+
+#define BCM_PLANES 4        // Bit-planes for the brightness levels (weights 1, 2, 4, 8)
+#define BCM_SEQ_LEN 16      // Scans in a brightness sequence (the plane weights plus a blank)
+#define BCM_SEQ_RING_BITS 8 // Size (bits) of a sequence (16 scans of 8 16-bit words = 256 bytes)
+#define BCM_SEQ_MASK ((1u << BCM_SEQ_RING_BITS) - 1)
+
+/**
+ * @brief State of the back set of frames.
+ * @ingroup panel
+ *
+ * FREE -> READY by the thread (once built). READY -> BUSY -> FREE by the panel tick.
+ */
+typedef enum _back_frames_state_ {
+    BACK_FREE = 0,  // Can be built
+    BACK_READY,     // Built, waiting for the tick to swap it to the front
+    BACK_BUSY,      // Just swapped out, but may still be in the PIO FIFO until the next tick
+} back_frames_state_t;
+
+/** The scan sequences for each set and blink frame. Read (as a ring) by the panel DMA channel. */
+volatile uint16_t _scan_seqs[2][FRAMES_COUNT][BCM_SEQ_LEN][DIGITS_CTRL_BUF_SIZE] __attribute__ ((aligned(1 << BCM_SEQ_RING_BITS)));
 #define DCB_SEGS_MASK 0x00FF
 #define DCB_DE_MASK 0xFF00
+static volatile int _front_frames;              // The set being scanned (0/1)
+static volatile back_frames_state_t _back_state;
 int _dma_channel_panel;     //The DMA channel to drive the panel
-int _dma_channel_control;   //The DMA channel that reloads the panel channel
-uint32_t _tran_count;       //The DMA transaction count
+repeating_timer_t _panel_tick_timer;
+
+/** Transfer count for the panel channel (~5 days), and the count left when the tick re-arms it (~5 seconds) */
+#define PANEL_DMA_TRANS_COUNT 0xFFFFFFFFu
+#define PANEL_DMA_REARM_COUNT 50000u
 
 PIO _pio_panel;             // The PIO to use for the panel
 
 /**
- * @brief Interrupt handler for our control DMA channel interrupt
+ * @brief PIO timing. The state machine runs at 1MHz (1us per cycle).
  * @ingroup panel
  *
- * This interrupt occurs every 0.84ms (105us * 8) and is used to
- * post a recurring message every 21ms (scan-end * 25) and to blink
- * the display digits.
+ * Each digit is: pull, out, set + (ON_LOOPS + 1) * (ON_DELAY + 1) on, then 5 dead.
+ * That is 3 + 96 + 5 = 104us, with the digit enabled for 97us.
+ */
+#define PANEL_PIO_ON_LOOPS 23
+#define PANEL_PIO_ON_DELAY 3
+#define PANEL_PIO_DEAD_DELAY 4
+
+/**
+ * @brief Build a set of scan sequences from the digit segments, brightness, and blinking digits.
+ * @ingroup panel
  *
+ * Scan `k` of a sequence uses plane (3 - trailing zeros of k+1), so plane 3 is every
+ * other scan, plane 2 every 4th, etc., and the last scan (k+1 = 16) is blank.
+ *
+ * @param set The set of sequences to build (must not be being scanned).
+ */
+static void _frames_build(int set) {
+    panel_digit_enable_t fast = _fast_blink_digit_ctrl;
+    panel_digit_enable_t slow = _slow_blink_digit_ctrl;
+    for (int f = 0; f < FRAMES_COUNT; f++) {
+        for (int k = 0; k < BCM_SEQ_LEN; k++) {
+            int plane = (BCM_PLANES - 1) - __builtin_ctz(k + 1);
+            volatile uint16_t* frame = _scan_seqs[set][f][k];
+            for (int i = 0; i < DIGITS_CTRL_BUF_SIZE - 1; i++) {
+                bool off = (((f & FRAME_FAST_OFF) && (fast & (1u << i))) || ((f & FRAME_SLOW_OFF) && (slow & (1u << i))));
+                bool on = (plane >= 0 && !off && (_digits_level[i] & (1u << plane)));
+                frame[i] = (uint16_t)(((1u << i) << 8) | (on ? _digits_segments[i] : 0x00));
+            }
+            frame[DIGITS_CTRL_BUF_SIZE - 1] = 0x0000; // The last word is the safety-fill
+        }
+    }
+}
+
+/**
+ * @brief Build the back set of frames if something changed and it is free.
+ * @ingroup panel
+ *
+ * Called on the 21ms repeat by the core that sets the panel. If the back set is
+ * still waiting to be swapped (or still being scanned), the changes are picked up
+ * on the next repeat.
  */
-void _on_dma_irq() {
-    // Interrupt at end of 'scan' when the 2nd channel re-programs the 1st.
+static void _frames_publish() {
+    if (_segments_changed && BACK_FREE == _back_state) {
+        _segments_changed = false;
+        _frames_build(_front_frames ^ 1);
+        __mem_fence_release();
+        _back_state = BACK_READY;
+    }
+}
+
+/**
+ * @brief Get the scan sequence of the front set for the current blink phases.
+ * @ingroup panel
+ */
+static volatile uint16_t* _scan_seq_current() {
+    int f = (_fast_blink_enable ? 0 : FRAME_FAST_OFF) | (_slow_blink_enable ? 0 : FRAME_SLOW_OFF);
+    return (_scan_seqs[_front_frames][f][0]);
+}
+
+/**
+ * @brief Restart the panel channel on the scan sequence for the current blink phases
+ * and front set, at the same offset in the sequence, with a full transfer count.
+ * @ingroup panel
+ *
+ * The channel is stopped before its read address is read. The address moves on
+ * when a read is issued, and an issued transfer still completes, so once stopped
+ * it is the next word that hasn't been sent. Restarting there doesn't repeat or
+ * skip a word (a digit never gets two slots in a row). The PIO FIFO holds a scan,
+ * so the stop doesn't show.
+ */
+static void _panel_dma_restart() {
+    dma_channel_abort(_dma_channel_panel);
+    uint32_t offset = dma_hw->ch[_dma_channel_panel].read_addr & BCM_SEQ_MASK;
+    dma_hw->ch[_dma_channel_panel].read_addr = (uint32_t)(uintptr_t)_scan_seq_current() | offset;
+    dma_hw->ch[_dma_channel_panel].al1_transfer_count_trig = PANEL_DMA_TRANS_COUNT;
+}
+
+/**
+ * @brief Panel tick (repeating timer) callback.
+ * @ingroup panel
+ *
+ * This occurs every 21ms and is used to post the recurring message, blink the
+ * display digits, swap in the back set of frames, and keep the panel channel
+ * running.
+ *
+ * @param rt The repeating timer (not used)
+ * @return true to keep repeating
+ */
+static bool _on_panel_tick(repeating_timer_t* rt) {
     bool post_blink_fast = false;
     bool post_blink_slow = false;
-    bool post_repetitive = false;
+    bool select = false;
 
-    // Clear the interrupt request.
-    dma_hw->ints1 = 1u << _dma_channel_control;
-
-    // Update the repetitive message counter
-    if (--_repetitive_count == 0) {
-        _repetitive_count = REPETITIVE_LOAD;
-        post_repetitive = true;
-    }
     // Update the blink counters
     if (--_fast_blink_count == 0) {
         _fast_blink_count = BLINK_FAST_LOAD;
         _fast_blink_enable = !_fast_blink_enable;
         post_blink_fast = true;
+        select = true;
     }
     if (--_slow_blink_count == 0) {
         _slow_blink_count = BLINK_SLOW_LOAD;
         _slow_blink_enable = !_slow_blink_enable;
         post_blink_slow = true;
+        select = true;
     }
 
-    if (_segments_changed) {
-        // Put the segments into the digits control buffer
-        _segments_changed = false;
-        for (int i=0; i < DIGITS_COUNT; i++) {
-            digsegs_t v = _digits_segments[i];
-            uint16_t ev = _digits_ctrl_buf[i];
-            ev = (ev & DCB_DE_MASK) | v;
-            _digits_ctrl_buf[i] = ev;
-        }
+    if (BACK_BUSY == _back_state) {
+        // The old front set has been out of the FIFO for a while, so it can be built again.
+        _back_state = BACK_FREE;
+    }
+    else if (BACK_READY == _back_state) {
+        _front_frames ^= 1;
+        _back_state = BACK_BUSY;
+        select = true;
+    }
+    // Switch the sequence, and re-arm the panel channel before it runs out.
+    if (select || dma_hw->ch[_dma_channel_panel].transfer_count < PANEL_DMA_REARM_COUNT) {
+        _panel_dma_restart();
     }
 
     // Post the messages.
-    if (post_repetitive) {
-        cmt_msg_t msg1 = { MSG_PANEL_REPEAT_21MS };
-        postBothMsgNoWait(&msg1);
-    }
+    cmt_msg_t msg1 = { MSG_PANEL_REPEAT_21MS };
+    postBothMsgNoWait(&msg1);
     if (post_blink_fast) {
         cmt_msg_t msg2 = { MSG_PANEL_BLINK_FAST_TGL };
         msg2.data.bv = _fast_blink_enable;
@@ -214,6 +358,8 @@ void _on_dma_irq() {
         msg3.data.bv = _slow_blink_enable;
         postBothMsgNoWait(&msg3);
     }
+
+    return (true);
 }
 
 
@@ -333,20 +479,41 @@ void panel_LinearB_set(linedots_t dots) {
     _segments_changed = true;
 }
 
+void panel_brightness_set(panel_digit_t digit, uint8_t level) {
+    _digits_level[digit] = (level < PANEL_BRIGHTNESS_MAX ? level : PANEL_BRIGHTNESS_MAX);
+    _segments_changed = true;
+}
+
+void panel_brightness_all_set(uint8_t level) {
+    level = (level < PANEL_BRIGHTNESS_MAX ? level : PANEL_BRIGHTNESS_MAX);
+    for (int i = 0; i < DIGITS_COUNT; i++) {
+        _digits_level[i] = level;
+    }
+    _segments_changed = true;
+}
+
+uint8_t panel_brightness(panel_digit_t digit) {
+    return (_digits_level[digit]);
+}
+
 void panel_digit_blink_fast_add(panel_digit_t digit) {
     _fast_blink_digit_ctrl |= (1u << digit);
+    _segments_changed = true;
 }
 
 void panel_digit_blink_fast_remove(panel_digit_t digit) {
     _fast_blink_digit_ctrl &= ~(1u << digit);
+    _segments_changed = true;
 }
 
 void panel_digit_blink_slow_add(panel_digit_t digit) {
     _slow_blink_digit_ctrl |= (1u << digit);
+    _segments_changed = true;
 }
 
 void panel_digit_blink_slow_remove(panel_digit_t digit) {
     _slow_blink_digit_ctrl &= ~(1u << digit);
+    _segments_changed = true;
 }
 
 linedots_t panel_linedots_for_value(uint8_t value) {
@@ -376,6 +543,7 @@ void panel_module_init(panel_type_t panel_type) {
 
     for (int i = 0; i < DIGITS_COUNT; i++) {
         _digits_segments[i] = 0xFF;
+        _digits_level[i] = PANEL_BRIGHTNESS_MAX;
     }
     _segments_changed = true;
     _fast_blink_enable = false;
@@ -384,94 +552,77 @@ void panel_module_init(panel_type_t panel_type) {
     _slow_blink_enable = false;
     _slow_blink_digit_ctrl = 0x00;
     _slow_blink_count = BLINK_SLOW_LOAD;
-    _repetitive_count = REPETITIVE_LOAD;
 
     _pio_panel = PIO_PANEL_DRIVE_BLOCK;
-    _tran_count = DIGITS_CTRL_BUF_SIZE;
 
-    // Create the PIO program. This simply reads a word from the fifo and outputs 15 bits to the GPIO.
+    // Create the PIO program. For each digit it pulls a word from the fifo, outputs 15 bits
+    // to the GPIO (segments and digit enable), holds them, then turns them all off for the
+    // dead time before pulling the next word:
+    //
+    //      pull block
+    //      out pins, 15
+    //      set x, ON_LOOPS
+    //  on:
+    //      jmp x-- on [ON_DELAY]
+    //      mov pins, null [DEAD_DELAY]
     //
-    // This is just a single `out pins, n` instruction with a wrap.
-    // So it's easier to just generate the PIO code than to create a source file, build it,
-    // load it, etc.
-    uint paneldrv_pio_prog = pio_encode_out(pio_pins, PANEL_PIO_GPIO_COUNT);
+    // It's easier to just generate the PIO code than to create a source file, build it,
+    // load it, etc. (`pio_add_program` relocates the jump).
+    uint16_t paneldrv_pio_prog[] = {
+        pio_encode_pull(false, true),
+        pio_encode_out(pio_pins, PANEL_PIO_GPIO_COUNT),
+        pio_encode_set(pio_x, PANEL_PIO_ON_LOOPS),
+        pio_encode_jmp_x_dec(3) | pio_encode_delay(PANEL_PIO_ON_DELAY),
+        pio_encode_mov(pio_pins, pio_null) | pio_encode_delay(PANEL_PIO_DEAD_DELAY),
+    };
     struct pio_program paneldrv_prog = {
-            .instructions = (const uint16_t *)&paneldrv_pio_prog,
-            .length = 1,
+            .instructions = paneldrv_pio_prog,
+            .length = count_of(paneldrv_pio_prog),
             .origin = -1
     };
     uint offset = pio_add_program(_pio_panel, &paneldrv_prog);
 
-    // Configure state machine to loop over this `out` instruction forever,
-    // with autopull enabled.
+    // Configure state machine to loop over the program forever.
     for (int i=0; i < PANEL_PIO_GPIO_COUNT; i++) {
             pio_gpio_init(_pio_panel, PANEL_PIO_GPIO_BASE + i);
     }
     pio_sm_set_consecutive_pindirs(_pio_panel, PIO_PANEL_DRIVE_SM, PANEL_PIO_GPIO_BASE, PANEL_PIO_GPIO_COUNT, true);
     pio_sm_config c = pio_get_default_sm_config();
     sm_config_set_out_pins(&c, PANEL_PIO_GPIO_BASE, PANEL_PIO_GPIO_COUNT);
-    sm_config_set_wrap(&c, offset, offset);
-    sm_config_set_clkdiv(&c, 1.0f);
-    sm_config_set_out_shift(&c, true, true, PANEL_PIO_GPIO_COUNT);
+    sm_config_set_wrap(&c, offset, offset + paneldrv_prog.length - 1);
+    sm_config_set_clkdiv(&c, (float)clock_get_hz(clk_sys) / 1000000.0f); // 1us per cycle
+    sm_config_set_out_shift(&c, true, false, 32);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX); // 8 entry FIFO (a full scan)
     pio_sm_init(_pio_panel, PIO_PANEL_DRIVE_SM, offset, &c);
 
-    // Initialize the digits control buffer with alternating segments on and stepping through the enables
-    uint8_t segs = 0;
-    for (int i = 0; i < DIGITS_CTRL_BUF_SIZE; i++) {
-        // if (i % 2 == 0) {segs = 0x6E;} else {segs = 0x61;}
-        if (i % 2 == 0) {segs = 0xFF;} else {segs = 0xFF;}
-        uint16_t de = (1 << i);
-        uint16_t v = (de << 8) + segs; // Store the digit enable and segments
-        _digits_ctrl_buf[i] = v;
-    }
-    _digits_ctrl_buf[DIGITS_CTRL_BUF_SIZE - 1] = 0x0000; // Zero out the last word for the safety-fill
+    // Initialize the frames (all segments on, stepping through the enables)
+    _front_frames = 0;
+    _back_state = BACK_FREE;
+    _frames_build(_front_frames);
+    _segments_changed = false;
 
     _dma_channel_panel = dma_claim_unused_channel(true);
-    _dma_channel_control = dma_claim_unused_channel(true);
-
-    dma_channel_config c1 = dma_channel_get_default_config(_dma_channel_control); //Get configurations for the control channel
-    channel_config_set_transfer_data_size(&c1, DMA_SIZE_32); //Set control channel data transfer size to 32 bits
-    channel_config_set_read_increment(&c1, false); //Set control channel read increment to false
-    channel_config_set_write_increment(&c1, false); //Set control channel write increment to false
-    // Configure control channel to write to panel channel's al1_transfer_count_trig register
-    dma_channel_configure(_dma_channel_control, &c1,
-        &dma_hw->ch[_dma_channel_panel].al1_transfer_count_trig,    // Trigger the panel DMA
-        &_tran_count,                                               // The value to write
-        1,                                                          // Transfer count
-        false);                                                     // Don't start yet
-
-    dma_channel_config c2 = dma_channel_get_default_config(_dma_channel_panel); //Get configurations for the panel channel
-    channel_config_set_transfer_data_size(&c2, DMA_SIZE_16); //Set panel channel data transfer size to 16 bits
-    channel_config_set_read_increment(&c2, true); //Set panel channel read increment to true
-    channel_config_set_write_increment(&c2, false); //Set panel channel write increment to false
-
-    // Configure the dma timer to transfer at a rate of once every 100 microseconds (10kHz)
-    int panel_dreq_timer = dma_claim_unused_timer(true);
-    dma_timer_set_fraction(panel_dreq_timer, 5, 65535); // (5/65535)*125000000 = 9537 (105 microseconds)
-    uint timer_dreq_id = dma_get_timer_dreq(panel_dreq_timer);
 
-    channel_config_set_dreq(&c2, timer_dreq_id); //Set the transfer request signal.
-    channel_config_set_chain_to(&c2, _dma_channel_control); //When the panel channel completes, trigger the control channel
-    channel_config_set_ring(&c2, false, 4); //Set read address wrapping to 4 bits (16 bytes)
+    dma_channel_config c1 = dma_channel_get_default_config(_dma_channel_panel); //Get configurations for the panel channel
+    channel_config_set_transfer_data_size(&c1, DMA_SIZE_16); //Set panel channel data transfer size to 16 bits
+    channel_config_set_read_increment(&c1, true); //Set panel channel read increment to true
+    channel_config_set_write_increment(&c1, false); //Set panel channel write increment to false
+    channel_config_set_ring(&c1, false, BCM_SEQ_RING_BITS); //Set read address wrapping to the sequence size
+    channel_config_set_dreq(&c1, pio_get_dreq(_pio_panel, PIO_PANEL_DRIVE_SM, true)); //Paced by the PIO (room in the TX FIFO)
 
     // Configure data channel to write to the PIO driving the panel
-    dma_channel_configure(_dma_channel_panel, &c2,
+    dma_channel_configure(_dma_channel_panel, &c1,
         &_pio_panel->txf[PIO_PANEL_DRIVE_SM],                       // Destination
-        _digits_ctrl_buf,                                           // Memory buffer to read from
-        DIGITS_CTRL_BUF_SIZE,                                       // Number of bytes to transfer in one block
+        _scan_seq_current(),                                        // Memory buffer to read from
+        PANEL_DMA_TRANS_COUNT,                                      // Number of words to transfer (re-armed by the tick)
         false);                                                     // Don't start yet
 
-    // Tell the DMA to raise IRQ line 1 when the channel finishes a block (used to time blinking)
-    dma_channel_set_irq1_enabled(_dma_channel_control, true);
-
-    // Configure the processor to run _on_dma_irq() when DMA IRQ 1 is asserted
-    irq_set_exclusive_handler(DMA_IRQ_1, _on_dma_irq);
-    irq_set_enabled(DMA_IRQ_1, true);
-
     // Start the PIO
     pio_sm_set_enabled(_pio_panel, PIO_PANEL_DRIVE_SM, true);
-    // Start the control channel. This will start the panel channel.
-    dma_start_channel_mask(1u << _dma_channel_control);
+    // Start the panel channel.
+    dma_channel_start(_dma_channel_panel);
+    // Start the panel tick.
+    add_repeating_timer_ms(-PANEL_TICK_MS, _on_panel_tick, NULL, &_panel_tick_timer);
 
     _initialized = true;
 }
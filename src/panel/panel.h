@@ -82,6 +82,9 @@ typedef enum _panel_type_ {
  */
 typedef uint32_t linedots_t; // Type to help control method params
 
+/** Maximum (full) brightness level of a digit. 0 is off. */
+#define PANEL_BRIGHTNESS_MAX 15
+
 
 /**
  * @brief Blank (clear) the panel.
@@ -239,6 +242,35 @@ extern void panel_LinearA_set(linedots_t dots);
  */
 extern void panel_LinearB_set(linedots_t dots);
 
+/**
+ * @brief Set the brightness level of a digit.
+ * @ingroup panel
+ *
+ * The level is applied by the panel DMA (binary-code-modulation over 16 scans),
+ * so it takes no CPU time. Like the segments, the change is shown within 21ms.
+ *
+ * @param digit The digit (or PANEL_INDICATORS)
+ * @param level The brightness level, 0 (off) to PANEL_BRIGHTNESS_MAX (full)
+ */
+extern void panel_brightness_set(panel_digit_t digit, uint8_t level);
+
+/**
+ * @brief Set the brightness level of all of the digits (and the indicators).
+ * @ingroup panel
+ *
+ * @param level The brightness level, 0 (off) to PANEL_BRIGHTNESS_MAX (full)
+ */
+extern void panel_brightness_all_set(uint8_t level);
+
+/**
+ * @brief Get the brightness level of a digit.
+ * @ingroup panel
+ *
+ * @param digit The digit (or PANEL_INDICATORS)
+ * @return uint8_t The brightness level (0-PANEL_BRIGHTNESS_MAX)
+ */
+extern uint8_t panel_brightness(panel_digit_t digit);
+
 /**
  * @brief Set a digit to blink fast.
  *
@@ -12,6 +12,7 @@ extern "C" {
 #endif
 #include "cmt/cmt.h"
 
+extern const msg_handler_entry_t _panel_repeat_handler_entry;
 extern const msg_handler_entry_t _panel_slowblnk_handler_entry;
 
 #ifdef __cplusplus
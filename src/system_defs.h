@@ -112,6 +112,18 @@ extern "C" {
 #define SW_BANK1_ADC            1           // Switch banks are read using the ADC
 #define SW_BANK2_GPIO           28          // Boards are set up to use IR or Switch Banks
 #define SW_BANK2_ADC            2           // Switch banks are read using the ADC
+// Ambient light sensor, if fitted (`amb_light` system config). There isn't a spare ADC
+// input: GPIO26 (ADC0) is the tone drive, GPIO27/28 (ADC1/2) are the IR or switch banks,
+// and GPIO29 (ADC3) is the Pico's on-board VSYS/3 divider (it isn't on the header). The
+// default needs the board changed - remove the VSYS divider from GPIO29 and wire the sensor
+// to it. Unmodified, the 'light' is the supply voltage. A board without the tone or one of
+// the switch banks can define these for that input instead.
+#ifndef AMB_LIGHT_GPIO
+#define AMB_LIGHT_GPIO          29          // Pico only - the Pico-W uses it for the radio
+#endif
+#ifndef AMB_LIGHT_ADC
+#define AMB_LIGHT_ADC           (AMB_LIGHT_GPIO - 26)   // ADC input for the GPIO
+#endif
 
 #define IRQ_INPUT_SW            IR_B_GPIO    // DP-33 - Shared with IR-B
 
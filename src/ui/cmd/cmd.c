@@ -12,6 +12,7 @@
 
 #include "debug_support.h"
 #include "cmt/cmt.h"
+#include "cmt/trace.h"
 #include "config/config.h"
 #include "config/config_cmd.h"
 #include "ui/scorekeeper/scorekeeper.h"
@@ -30,6 +31,7 @@ static char _cmdline_parsed[UI_TERM_GETLINE_MAX_LEN_];
 static int _cmd_help(int argc, char** argv, const char* unparsed);
 static int _cmd_keys(int argc, char** argv, const char* unparsed);
 static int _cmd_proc_status(int argc, char** argv, const char* unparsed);
+static int _cmd_trace(int argc, char** argv, const char* unparsed);
 
 // Command processors framework
 static const cmd_handler_entry_t _cmd_help_entry = {
@@ -50,8 +52,15 @@ static const cmd_handler_entry_t _cmd_proc_status_entry = {
     _cmd_proc_status,
     3,
     ".ps",
-    "[-m|--msg]",
-    "Display process status per second.\n  -m|--msg : Display MSG ID of scheduled messages.\n",
+    "[-m|--msg | -l|--lanes | -h|--hist | -t|--trend]",
+    "Display process status per second.\n  -m|--msg : Display MSG ID of scheduled messages.\n  -l|--lanes : Display (and reset) the message lane depth/latency statistics.\n  -h|--hist : Display (and reset) the message wait/handler time histograms.\n  -t|--trend : Display the load trend (per second) for the last minute.\n",
+};
+static const cmd_handler_entry_t _cmd_trace_entry = {
+    _cmd_trace,
+    3,
+    ".trace",
+    "[-c|--clear | -b|--binary]",
+    "Display the message trace as Chrome Trace (Perfetto) JSON.\n  -c|--clear : Clear the trace.\n  -b|--binary : Display the binary dump (as hex, use 'xxd -r -p' to get the bytes).\n",
 };
 
 /**
@@ -60,6 +69,7 @@ static const cmd_handler_entry_t _cmd_proc_status_entry = {
 static const cmd_handler_entry_t* _command_entries[] = {
     & cmd_debug_support_entry,  // .debug - 'DOT' commands come first
     & _cmd_proc_status_entry,   // .ps
+    & _cmd_trace_entry,         // .trace
     & cmd_bootcfg_entry,
     & cmd_cfg_entry,
     & cmd_configure_entry,
@@ -150,6 +160,99 @@ static void _cmd_ps_print(const proc_status_accum_t* ps, int corenum) {
     int uaf = (ONE_SECOND_US - (ps->t_active + ps->t_idle + ps->t_msg_retrieve)) / 1000;
     ui_term_printf("Core %d: Temp:%0.1f Retrieved:%u Idle:%u Active-us:%lu Idle-us:%lu Retrieve-us:%lu ?-ms:%d Intr:0x%0.8x\n",
         corenum, ps->core_temp, ps->retrieved, ps->idle, ps->t_active, ps->t_idle, ps->t_msg_retrieve, uaf, ps->interrupt_status);
+    ui_term_printf("        Batches 1:%u 2-3:%u 4-7:%u 8+:%u\n", ps->batches[0], ps->batches[1], ps->batches[2], ps->batches[3]);
+}
+
+static void _cmd_ps_hist_print(const char* label, const uint16_t* counts) {
+    // Only print the buckets with counts. Bucket `b` is times < 2^b us.
+    ui_term_printf("  %s", label);
+    for (int b = 0; b < CMT_HIST_BUCKETS; b++) {
+        if (counts[b]) {
+            if (b < CMT_HIST_BUCKETS - 1) {
+                ui_term_printf(" <%uus:%u", (1u << b), counts[b]);
+            }
+            else {
+                ui_term_printf(" >=%uus:%u", (1u << (b - 1)), counts[b]);
+            }
+        }
+    }
+    ui_term_printf("\n");
+}
+
+static void _cmd_ps_hists_print(int corenum) {
+    cmt_msg_hist_t hist;
+    for (int n = 0; cmt_msg_hist(corenum, n, &hist); n++) {
+        ui_term_printf("Core %d Msg: 0x%03X\n", corenum, hist.msg_id);
+        _cmd_ps_hist_print("Wait   :", hist.wait);
+        _cmd_ps_hist_print("Handler:", hist.handler);
+    }
+    cmt_msg_hist_reset(corenum);
+}
+
+static void _cmd_ps_drops_print() {
+    ui_term_printf("Dropped posts: Core 0 High:%u Normal:%u  Core 1 High:%u Normal:%u\n",
+        multicore_drops(0, MSG_LANE_HIGH), multicore_drops(0, MSG_LANE_NORMAL),
+        multicore_drops(1, MSG_LANE_HIGH), multicore_drops(1, MSG_LANE_NORMAL));
+    // List the message IDs that have been dropped
+    for (int block = 0; block < MSG_ID_BLOCKS_NUM; block++) {
+        for (int i = 0; i < MSG_ID_BLOCK_SIZE; i++) {
+            msg_id_t id = (msg_id_t)((block << 8) | i);
+            uint32_t drops = multicore_drops_for_id(id);
+            if (drops) {
+                ui_term_printf(" Dropped Msg: 0x%03X : %u\n", id, drops);
+            }
+        }
+    }
+}
+
+static void _cmd_ps_overruns_print() {
+    for (uint8_t corenum = 0; corenum < 2; corenum++) {
+        cmt_overrun_t overruns[CMT_OVERRUNS_MAX];
+        int n = cmt_overruns(corenum, overruns, CMT_OVERRUNS_MAX);
+        ui_term_printf("Core %d handler overruns: %u\n", corenum, cmt_overrun_count(corenum));
+        for (int i = 0; i < n; i++) {
+            cmt_overrun_t* o = &overruns[i];
+            if (o->msg_id == CMT_ACTIVITY_POLLER) {
+                ui_term_printf(" Poller  Fn:%p  %uus at %ums\n", o->fn, o->duration_us, o->ts_ms);
+            }
+            else {
+                ui_term_printf(" Msg: 0x%03X Fn:%p  %uus at %ums\n", o->msg_id, o->fn, o->duration_us, o->ts_ms);
+            }
+        }
+    }
+    cmt_crash_record_t cr;
+    if (cmt_crash_record(&cr)) {
+        ui_term_printf("Stall reboot record: Core:%d Msg:0x%03X Fn:%p Stalled-ms:%u%s\n",
+            cr.corenum, cr.msg_id, cr.fn, cr.stalled_ms, (cmt_diag_mode() ? " (Diagnostic Mode)" : ""));
+    }
+}
+
+static void _cmd_ps_trend_print(int corenum) {
+    cmt_ps_sample_t samples[CMT_PS_HISTORY_SECS];
+    int n = cmt_proc_status_history(corenum, samples, CMT_PS_HISTORY_SECS);
+    float temp_min = 0.0f, temp_max = 0.0f;
+    ui_term_printf("Core %d (oldest first, %ds)\n  Busy%%:", corenum, n);
+    for (int i = 0; i < n; i++) {
+        // Busy is the time not idle in the second
+        uint32_t total = samples[i].t_active + samples[i].t_idle + samples[i].t_msg_retrieve;
+        uint32_t busy = (total ? (100 * (total - samples[i].t_idle)) / total : 0);
+        ui_term_printf(" %u", busy);
+        if (i == 0 || samples[i].core_temp < temp_min) {
+            temp_min = samples[i].core_temp;
+        }
+        if (i == 0 || samples[i].core_temp > temp_max) {
+            temp_max = samples[i].core_temp;
+        }
+    }
+    ui_term_printf("\n  Msgs:");
+    for (int i = 0; i < n; i++) {
+        ui_term_printf(" %u", samples[i].retrieved);
+    }
+    ui_term_printf("\n  Depth:");
+    for (int i = 0; i < n; i++) {
+        ui_term_printf(" %u", samples[i].queue_depth);
+    }
+    ui_term_printf("\n  Temp: %0.1f-%0.1f\n", temp_min, temp_max);
 }
 
 static int _cmd_proc_status(int argc, char** argv, const char* unparsed) {
@@ -159,13 +262,25 @@ static int _cmd_proc_status(int argc, char** argv, const char* unparsed) {
         return (-1);
     }
     proc_status_accum_t ps0, ps1;
-    int smwc;
+    int smwc, smcap, smhw;
     bool showmsgs = false;
+    bool showlanes = false;
+    bool showhists = false;
+    bool showtrend = false;
     if (argc > 1) {
         // They entered an option and/or command names
         if (strcmp("-m", argv[1]) == 0 || strcmp("--msg", argv[1]) == 0) {
             showmsgs = true;
         }
+        else if (strcmp("-l", argv[1]) == 0 || strcmp("--lanes", argv[1]) == 0) {
+            showlanes = true;
+        }
+        else if (strcmp("-h", argv[1]) == 0 || strcmp("--hist", argv[1]) == 0) {
+            showhists = true;
+        }
+        else if (strcmp("-t", argv[1]) == 0 || strcmp("--trend", argv[1]) == 0) {
+            showtrend = true;
+        }
         else {
             // Not our argument.
             cmd_help_display(&_cmd_proc_status_entry, HELP_DISP_USAGE);
@@ -176,14 +291,41 @@ static int _cmd_proc_status(int argc, char** argv, const char* unparsed) {
     cmt_proc_status_sec(&ps0, 0);
     cmt_proc_status_sec(&ps1, 1);
     smwc = cmt_sched_msg_waiting();
+    cmt_sched_msg_pool_status(&smcap, &smhw);
     _cmd_ps_print(&ps0, 0);
     _cmd_ps_print(&ps1, 1);
-    ui_term_printf("Scheduled messages: %d\n", smwc);
+    ui_term_printf("Scheduled messages: %d  Pool:%d High-water:%d\n", smwc, smcap, smhw);
+    int slab_blocks, slab_hw;
+    multicore_slab_status(&slab_blocks, &slab_hw);
+    ui_term_printf("Message data slab: Blocks:%d High-water:%d\n", slab_blocks, slab_hw);
+    _cmd_ps_drops_print();
+    _cmd_ps_overruns_print();
+    if (showlanes) {
+        for (uint8_t corenum = 0; corenum < 2; corenum++) {
+            for (int lane = 0; lane < MSG_LANES_NUM; lane++) {
+                msg_lane_stats_t ls;
+                multicore_lane_stats(corenum, (msg_lane_t)lane, &ls);
+                uint32_t avg = (ls.retrieved ? (uint32_t)(ls.latency_us_total / ls.retrieved) : 0);
+                ui_term_printf("Core %d %s lane: Retrieved:%u Depth-max:%u Latency-us avg:%u max:%u\n",
+                    corenum, (lane == MSG_LANE_HIGH ? "High" : "Normal"), ls.retrieved, ls.depth_max, avg, ls.latency_us_max);
+            }
+            ui_term_printf("Core %d coalesced posts: %u\n", corenum, multicore_coalesced(corenum));
+            multicore_lane_stats_reset(corenum);
+        }
+    }
+    if (showhists) {
+        _cmd_ps_hists_print(0);
+        _cmd_ps_hists_print(1);
+    }
+    if (showtrend) {
+        _cmd_ps_trend_print(0);
+        _cmd_ps_trend_print(1);
+    }
     if (smwc > 0) {
         if (showmsgs) {
-            uint16_t msgs[SCHEDULED_MESSAGES_MAX];
-            cmt_sched_msg_waiting_ids(SCHEDULED_MESSAGES_MAX, msgs);
-            for (int i=0; i<SCHEDULED_MESSAGES_MAX; i++) {
+            uint16_t msgs[SCHEDULED_MESSAGES_LIMIT];
+            cmt_sched_msg_waiting_ids(SCHEDULED_MESSAGES_LIMIT, msgs);
+            for (int i=0; i<SCHEDULED_MESSAGES_LIMIT; i++) {
                 uint16_t id = msgs[i];
                 if ((int16_t)id < 0) {
                     break;  // End of messages
@@ -219,6 +361,41 @@ static int _cmd_proc_status(int argc, char** argv, const char* unparsed) {
     return (0);
 }
 
+static void _cmd_trace_writer(const char* str, void* user_data) {
+    ui_term_printf("%s", str);
+}
+
+static void _cmd_trace_bin_writer(const uint8_t* data, int len, void* user_data) {
+    for (int i = 0; i < len; i++) {
+        ui_term_printf("%02x", data[i]);
+    }
+    ui_term_printf("\n");
+}
+
+static int _cmd_trace(int argc, char** argv, const char* unparsed) {
+    if (argc > 2) {
+        // We only take a single argument.
+        cmd_help_display(&_cmd_trace_entry, HELP_DISP_USAGE);
+        return (-1);
+    }
+    if (argc > 1) {
+        if (strcmp("-c", argv[1]) == 0 || strcmp("--clear", argv[1]) == 0) {
+            cmt_trace_clear();
+            return (0);
+        }
+        if (strcmp("-b", argv[1]) == 0 || strcmp("--binary", argv[1]) == 0) {
+            cmt_trace_write_bin(_cmd_trace_bin_writer, NULL);
+            return (0);
+        }
+        // Not our argument.
+        cmd_help_display(&_cmd_trace_entry, HELP_DISP_USAGE);
+        return (-1);
+    }
+    cmt_trace_write_json(_cmd_trace_writer, NULL);
+
+    return (0);
+}
+
 
 // Internal functions
 
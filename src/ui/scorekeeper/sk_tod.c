@@ -10,6 +10,7 @@
 #include "panel/panel.h"
 #include "panel/segments7/segments7.h"
 #include "sk_screen.h"
+#include "ui/ui.h"
 #include "ui/ui_term.h"
 #include "util/util.h"
 
@@ -30,6 +31,7 @@ const msg_handler_entry_t _sk_tod_update_handler_entry = { MSG_PANEL_TOD_UPDATE,
 const cmt_msg_t _tod_update_msg = { MSG_PANEL_TOD_UPDATE };
 
 bool _enabled;
+cmt_handle_t _tod_update_handle;
 uint8_t _indicators;
 
 
@@ -74,12 +76,6 @@ void _update_sk_tod() {
         }
         panel_IND_set(_indicators);
         skscrn_IND_set(_indicators);
-        // Schedule us to run again
-        schedule_core1_msg_in_ms(100, &_tod_update_msg); // Run again in 100ms
-    }
-    else {
-        // Remove any pending scheduled message
-        scheduled_msg_cancel(MSG_PANEL_TOD_UPDATE);
     }
 }
 
@@ -90,6 +86,17 @@ void _update_sk_tod() {
 //
 void sk_tod_enable(bool enable) {
     _enabled = enable;
+    if (enable) {
+        if (CMT_HANDLE_INVALID == _tod_update_handle) {
+            // Update every 100ms
+            _tod_update_handle = cmt_schedule_periodic(UI_CORE_NUM, 100, 100, &_tod_update_msg);
+        }
+    }
+    else {
+        // Stop the periodic update
+        cmt_cancel(_tod_update_handle);
+        _tod_update_handle = CMT_HANDLE_INVALID;
+    }
     // Wake up display of the time of day.
     _update_sk_tod();
 }
@@ -97,5 +104,6 @@ void sk_tod_enable(bool enable) {
 void sk_tod_module_init() {
     _enabled = false;
     _indicators = 0;
+    _tod_update_handle = CMT_HANDLE_INVALID;
 }
 
@@ -19,6 +19,7 @@
 #include "cmt/multicore.h"
 #include "config/config.h"
 #include "curswitch/curswitch.h"
+#include "panel/panel_msg_hndlr.h"
 #include "rc/rc.h"
 #include "scorekeeper/sk_app.h"
 #include "scorekeeper/sk_tod.h"
@@ -32,13 +33,21 @@
 
 #define _UI_STATUS_PULSE_PERIOD 7001
 
-typedef enum _UI_App_ID_ {
-    APP_NONE    = 0,
-    APP_SCORES  = 1,
-    APP_SETUP   = 2,
-} ui_app_id_t;
-
-static ui_app_id_t _app_active;
+/**
+ * @brief A UI app. The app's message subscriptions call its functions.
+ * @ingroup ui
+ *
+ * Only the active app's subscriptions are dispatched to.
+ */
+typedef struct _UI_APP_ {
+    void (*rc_action)(rc_action_data_t action, bool longpress);
+    void (*rc_entry)(rc_value_entry_t entry);
+    void (*switch_action)(switch_bank_t bank, switch_id_t sw_id, bool pressed, bool long_press, bool repeat);
+    cmt_app_subs_t subs;
+} ui_app_t;
+
+static ui_app_t _sk_app = { sk_app_rc_action, sk_app_rc_entry, sk_app_switch_action };
+static ui_app_t _setup_app = { setup_app_rc_action, setup_app_rc_entry, setup_app_switch_action };
 static bool _initialized = false;
 
 // Internal, non message handler, function declarations
@@ -57,7 +66,13 @@ static void _handle_rc_value_entered(cmt_msg_t* msg);
 static void _handle_switch_action(cmt_msg_t* msg);
 static void _handle_switch_longpress(cmt_msg_t* msg);
 
-static void _ui_idle_function_1();
+// App message subscriber functions...
+static void _app_rc_action(cmt_msg_t* msg, void* ctx);
+static void _app_rc_longpress(cmt_msg_t* msg, void* ctx);
+static void _app_rc_value_entered(cmt_msg_t* msg, void* ctx);
+static void _app_switch_action(cmt_msg_t* msg, void* ctx);
+static void _app_switch_longpress(cmt_msg_t* msg, void* ctx);
+static void _sk_app_rc_longpress(cmt_msg_t* msg, void* ctx);
 
 static cmt_msg_t _msg_ui_initialized;
 
@@ -76,11 +91,15 @@ static const msg_handler_entry_t _switch_longpress_handler_entry = { MSG_SWITCH_
  * @brief List of handler entries.
  * @ingroup ui
  *
- * For performance, put these in the order that we expect to receive the most (most -> least).
+ * Dispatch is by message ID (table lookup), so the order here doesn't matter
+ * (except for multiple handlers of the same ID, which are called in list order).
  *
  */
 static const msg_handler_entry_t* _handler_entries[] = {
     & cmt_sm_tick_handler_entry,
+    & cmt_call_handler_entry,
+    & cmt_call_timeout_handler_entry,
+    &_panel_repeat_handler_entry,
     &_sk_tod_update_handler_entry,
     &_rc_action_handler_entry,
     &_switch_action_handler_entry,
@@ -95,27 +114,23 @@ static const msg_handler_entry_t* _handler_entries[] = {
     ((msg_handler_entry_t*)0), // Last entry must be a NULL
 };
 
-static const idle_fn _ui_idle_functions[] = {
-    (idle_fn)_ui_idle_function_1,
-    (idle_fn)0, // Last entry must be a NULL
+/**
+ * @brief List of idle pollers.
+ * @ingroup ui
+ *
+ * The UI doesn't need any, so the core sleeps until it has something to do.
+ */
+static const idle_poller_entry_t* _ui_idle_pollers[] = {
+    ((idle_poller_entry_t*)0), // Last entry must be a NULL
 };
 
 msg_loop_cntx_t ui_msg_loop_cntx = {
     UI_CORE_NUM, // UI runs on Core 1
     _handler_entries,
-    _ui_idle_functions,
+    _ui_idle_pollers,
 };
 
 
-// ============================================
-// Idle functions
-// ============================================
-
-static void _ui_idle_function_1() {
-    // Something to do when there are no messages to process.
-}
-
-
 // ============================================
 // Message handler functions
 // ============================================
@@ -188,17 +203,6 @@ static void _handle_rc_action(cmt_msg_t* msg) {
     // Don't do anything if it is a repeat. We use the LONGPRESS message for that.
     if (!repeat) {
         info_printf(false, "Remote: %d\n", code);
-        switch (_app_active) {
-            case APP_SCORES:
-                sk_app_rc_action(action, false);
-                break;
-            case APP_SETUP:
-                setup_app_rc_action(action, false);
-                break;
-            case APP_NONE:
-                // No application active. Nothing to do.
-                break;
-        }
     }
 }
 
@@ -217,24 +221,6 @@ static void _handle_rc_longpress(cmt_msg_t* msg) {
     bool repeat = msg->data.rc_action.repeat;
     const char* repeatstr = (repeat ? " repeat" : "");
     info_printf(false, "Remote: %d Long Press%s\n", code, repeatstr);
-    switch (_app_active) {
-        case APP_SCORES:
-            // If this is a LONG-PRESS+REPEAT of the MENU button, enter the Setup App.
-            if (repeat && code == RC_MENU) {
-                if (setup_app_run(_ui_setup_app_done)) {
-                    _app_active = APP_SETUP;
-                    return;
-                }
-            }
-            sk_app_rc_action(action, true);
-            break;
-        case APP_SETUP:
-            setup_app_rc_action(action, true);
-            break;
-        case APP_NONE:
-            // No application active. Nothing to do.
-            break;
-    }
 }
 
 /**
@@ -251,17 +237,6 @@ static void _handle_rc_value_entered(cmt_msg_t* msg) {
     int value = msg->data.rc_entry.value;
     int divisor = msg->data.rc_entry.divisor;
     info_printf(false, "Remote value entered: %d  Divisor: %d  Terminator: %d\n", value, divisor, code);
-    switch (_app_active) {
-        case APP_SCORES:
-            sk_app_rc_entry(msg->data.rc_entry);
-            break;
-        case APP_SETUP:
-            setup_app_rc_entry(msg->data.rc_entry);
-            break;
-        case APP_NONE:
-            // No application active. Nothing to do.
-            break;
-    }
 }
 
 /**
@@ -282,17 +257,6 @@ static void _handle_switch_action(cmt_msg_t* msg) {
     const char* swname = curswitch_shortname_for_swid(sw_id);
     state = (pressed ? "Pressed" : "Released");
     info_printf(false, "Bank%d %s %s\n", bank, swname, state);
-    switch (_app_active) {
-        case APP_SCORES:
-            sk_app_switch_action(bank, sw_id, pressed, false, false);
-            break;
-        case APP_SETUP:
-            setup_app_switch_action(bank, sw_id, pressed, false, false);
-            break;
-        case APP_NONE:
-            // No application active. Nothing to do.
-            break;
-    }
 }
 
 /**
@@ -311,19 +275,94 @@ static void _handle_switch_longpress(cmt_msg_t* msg) {
     const char* swname = curswitch_shortname_for_swid(sw_id);
     const char* repeatstr = (repeat ? " repeat" : "");
     debug_printf(false, "Bank%d %s Long Press%s\n", bank, swname, repeatstr);
-    switch (_app_active) {
-        case APP_SCORES:
-            sk_app_switch_action(bank, sw_id, true, true, repeat);
-            break;
-        case APP_SETUP:
-            setup_app_switch_action(bank, sw_id, true, true, repeat);
-            break;
-        case APP_NONE:
-            // No application active. Nothing to do.
-            break;
+}
+
+// ============================================
+// App message subscriber functions
+// ============================================
+
+/**
+ * @brief App subscriber for MSG_RC_ACTION
+ * @ingroup ui
+ *
+ * @param msg Contains a rc_action_data_t structure.
+ * @param ctx The app (ui_app_t).
+ */
+static void _app_rc_action(cmt_msg_t* msg, void* ctx) {
+    const ui_app_t* app = (const ui_app_t*)ctx;
+    // Don't do anything if it is a repeat. We use the LONGPRESS message for that.
+    if (!msg->data.rc_action.repeat) {
+        app->rc_action(msg->data.rc_action, false);
     }
 }
 
+/**
+ * @brief App subscriber for MSG_RC_LONGPRESS
+ * @ingroup ui
+ *
+ * @param msg Contains a rc_action_data_t structure.
+ * @param ctx The app (ui_app_t).
+ */
+static void _app_rc_longpress(cmt_msg_t* msg, void* ctx) {
+    const ui_app_t* app = (const ui_app_t*)ctx;
+    app->rc_action(msg->data.rc_action, true);
+}
+
+/**
+ * @brief Scorekeeper app subscriber for MSG_RC_LONGPRESS
+ * @ingroup ui
+ *
+ * A LONG-PRESS+REPEAT of the MENU button enters the Setup app.
+ *
+ * @param msg Contains a rc_action_data_t structure.
+ * @param ctx The app (ui_app_t).
+ */
+static void _sk_app_rc_longpress(cmt_msg_t* msg, void* ctx) {
+    if (msg->data.rc_action.repeat && msg->data.rc_action.code == RC_MENU) {
+        if (setup_app_run(_ui_setup_app_done)) {
+            cmt_app_activate(UI_CORE_NUM, &_setup_app.subs);
+            return;
+        }
+    }
+    _app_rc_longpress(msg, ctx);
+}
+
+/**
+ * @brief App subscriber for MSG_RC_VALUE_ENTERED
+ * @ingroup ui
+ *
+ * @param msg Contains a rc_entry_data_t structure.
+ * @param ctx The app (ui_app_t).
+ */
+static void _app_rc_value_entered(cmt_msg_t* msg, void* ctx) {
+    const ui_app_t* app = (const ui_app_t*)ctx;
+    app->rc_entry(msg->data.rc_entry);
+}
+
+/**
+ * @brief App subscriber for MSG_SWITCH_ACTION
+ * @ingroup ui
+ *
+ * @param msg Contains a switch_action_data_t structure.
+ * @param ctx The app (ui_app_t).
+ */
+static void _app_switch_action(cmt_msg_t* msg, void* ctx) {
+    const ui_app_t* app = (const ui_app_t*)ctx;
+    app->switch_action(msg->data.sw_action.bank, msg->data.sw_action.switch_id, msg->data.sw_action.pressed, false, false);
+}
+
+/**
+ * @brief App subscriber for MSG_SWITCH_LONGPRESS
+ * @ingroup ui
+ *
+ * @param msg Contains a switch_action_data_t structure.
+ * @param ctx The app (ui_app_t).
+ */
+static void _app_switch_longpress(cmt_msg_t* msg, void* ctx) {
+    const ui_app_t* app = (const ui_app_t*)ctx;
+    app->switch_action(msg->data.sw_action.bank, msg->data.sw_action.switch_id, true, true, msg->data.sw_action.repeat);
+}
+
 // ============================================
 // Internal functions
 // ============================================
@@ -333,10 +372,26 @@ static void _handle_switch_longpress(cmt_msg_t* msg) {
  * @ingroup ui
  */
 void _ui_setup_app_done(void) {
-    _app_active = APP_SCORES;
+    cmt_app_activate(UI_CORE_NUM, &_sk_app.subs);
     sk_app_refresh();
 }
 
+/**
+ * @brief Subscribe an app to the input messages.
+ * @ingroup ui
+ *
+ * @param app The app.
+ * @param rc_longpress The subscriber for MSG_RC_LONGPRESS.
+ */
+static void _ui_app_subscribe(ui_app_t* app, cmt_subscriber_fn rc_longpress) {
+    cmt_app_subs_init(&app->subs, UI_CORE_NUM);
+    cmt_app_subscribe(&app->subs, MSG_RC_ACTION, _app_rc_action, app);
+    cmt_app_subscribe(&app->subs, MSG_RC_LONGPRESS, rc_longpress, app);
+    cmt_app_subscribe(&app->subs, MSG_RC_VALUE_ENTERED, _app_rc_value_entered, app);
+    cmt_app_subscribe(&app->subs, MSG_SWITCH_ACTION, _app_switch_action, app);
+    cmt_app_subscribe(&app->subs, MSG_SWITCH_LONGPRESS, _app_switch_longpress, app);
+}
+
 void _ui_init_terminal_shell() {
     ui_term_build();
     cmd_module_init();
@@ -410,15 +465,17 @@ bool ui_initialized() {
  * @brief Initialize the User Interface (now that the message loop is running).
  */
 void ui_module_init() {
-    _app_active = APP_NONE;
+    cmt_app_activate(UI_CORE_NUM, NULL);
     ui_disp_build();
     _ui_init_terminal_shell();
     // Initialize the Setup functionality
     setup_module_init();
+    _ui_app_subscribe(&_setup_app, _app_rc_longpress);
     // Initialize the Score Keeper app
     sk_app_module_init();
+    _ui_app_subscribe(&_sk_app, _sk_app_rc_longpress);
     // Start out in the Scorekeeper functionality (switches to Setup at times)
-    _app_active = APP_SCORES;
+    cmt_app_activate(UI_CORE_NUM, &_sk_app.subs);
 
     // Let the Backend know that we are initialized
     _initialized = true;